@@ -0,0 +1,118 @@
+#include "syshead.h"
+
+#include "arena.h"
+#include "consts.h"
+#include "structs.h"
+
+/**
+ * @brief A block of the row arena. Slots are taken from the block one after
+ *        the other until it is full, and the block is freed once none of
+ *        them are used (the current block is reused from the start instead).
+ *
+ * {
+ *      size_t size; (number of bytes in data)
+ *      size_t used; (number of bytes of data taken by slots)
+ *      long slots; (number of slots in the block still used)
+ *      char data[]; (the slots, each after its slotHead)
+ * }
+ */
+struct arenaBlock {
+    size_t size;
+    size_t used;
+    long slots;
+    char data[];
+};
+
+/**
+ * @brief Kept right before the text of every slot.
+ *
+ * {
+ *      struct arenaBlock *block; (the block the slot is in)
+ *      size_t cap; (number of bytes of text the slot has room for)
+ * }
+ */
+struct slotHead {
+    struct arenaBlock *block;
+    size_t cap;
+};
+
+/**
+ * @brief The head of the slot holding @chars.
+ *
+ * @param chars (the text of the slot)
+ * @return struct slotHead* (the head of the slot)
+ */
+static struct slotHead *head_of(char *chars) {
+    return (struct slotHead *)(chars - sizeof(struct slotHead));
+}
+
+/**
+ * @brief Takes an empty slot from the current block of the arena, starting
+ *        a new block if the current one has no room for it.
+ *
+ * @param state (pointer to the editor state object)
+ * @param cap (number of bytes of text the slot has room for)
+ * @return char* (the text of the slot)
+ */
+static char *new_slot(eState *state, size_t cap) {
+    struct arenaBlock *block = state->arena;
+    size_t need = sizeof(struct slotHead) + cap;
+    size_t start = 0;
+    if (block != NULL) // heads are aligned for their pointer
+        start = (block->used + sizeof(struct slotHead) - 1) & ~(sizeof(struct slotHead) - 1);
+    if (block == NULL || start + need > block->size) {
+        if (block != NULL && block->slots == 0)
+            free(block);
+        size_t size = need > EDDIE_ARENA_BLOCK ? need : EDDIE_ARENA_BLOCK;
+        block = malloc(sizeof(struct arenaBlock) + size);
+        block->size = size;
+        block->used = 0;
+        block->slots = 0;
+        state->arena = block;
+        start = 0;
+    }
+
+    struct slotHead *head = (struct slotHead *)&block->data[start];
+    head->block = block;
+    head->cap = cap;
+    block->used = start + need;
+    block->slots++;
+    return (char *)&head[1];
+}
+
+char *editorArenaNew(eState *state, const char *s, size_t len) {
+    char *chars = new_slot(state, len + 1); // extra character for null-termination
+    memcpy(chars, s, len);
+    chars[len] = '\0';
+    return chars;
+}
+
+char *editorArenaGrow(eState *state, char *chars, size_t size, size_t len) {
+    struct slotHead *head = head_of(chars);
+    if (len + 1 <= head->cap)
+        return chars;
+
+    struct arenaBlock *block = head->block;
+    if (chars + head->cap == &block->data[block->used] && block->used + len + 1 - head->cap <= block->size) {
+        block->used += len + 1 - head->cap; // the last slot of its block takes the room after it
+        head->cap = len + 1;
+        return chars;
+    }
+
+    // slots moving to the end grow by half as much again, so a row edited
+    // between other rows only moves every so often
+    char *moved = new_slot(state, len + 1 + len / 2);
+    memcpy(moved, chars, size);
+    editorArenaRelease(state, chars);
+    return moved;
+}
+
+void editorArenaRelease(eState *state, char *chars) {
+    struct arenaBlock *block = head_of(chars)->block;
+    if (--block->slots > 0)
+        return;
+    if (block == state->arena)
+        block->used = 0; // the current block is reused from the start
+    else
+        free(block);
+}
@@ -1,53 +1,244 @@
 #include "syshead.h"
 
 #include "buffer.h"
+#include "arena.h"
+#include "cache.h"
 #include "consts.h"
+#include "file.h"
 #include "highlight.h"
+#include "journal.h"
+#include "lineidx.h"
+#include "rowidx.h"
+#include "slab.h"
 #include "structs.h"
+#include "terminal.h"
+#include "window.h"
+#include "wrap.h"
 
 /**
- * @brief Calculates character distance from @at to next
- *        space in row / end of row
+ * @brief Releases the actual string of a row, unless it is not owned by
+ *        the row or a background save still reads it.
  * 
- * @param row (relevant erow pointer)
- * @param at (location to start calculating from)
- * @return int (distance to the next space / eor)
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
  */
-static int distance_to_next_space(erow *row, int at) {
-    int j;
-    for (j = at + 1; j < row->size; j++) {
-        if (isspace(row->chars[j]))
-            break;
-    }
-    return j - at;
+static void free_chars(eState *state, erow *row) {
+    if ((ROW_FLAGS(row) & ROW_SHARED) && state->save)
+        editorSaveKeep(state, row->chars);
+    else if (!(ROW_FLAGS(row) & ROW_MAPPED))
+        editorArenaRelease(state, row->chars);
 }
 
 /**
- * @brief Calculates character distance to @at from previous
- *        space in row / start of row
+ * @brief Frees the render details of a row (everything editorUpdateRow builds).
  * 
- * @param row (relevant erow pointer)
- * @param at (location to start calculating from)
- * @return int (distance to the next space / sor)
+ * @param row (the row)
  */
-static int distance_from_prev_space(erow *row, int at) {
-    int j;
-    for (j = at - 1; j >= 0; j--) {
-        if (isspace(row->chars[j]))
-            break;
-    }
-    return at - j;
+static void free_render(erow *row) {
+    if (row->rd == NULL)
+        return;
+    slabFree(row->rd->wrap_stops);
+    slabFree(row->rd); // render, hl and bg are in the same block
+    row->rd = NULL;
 }
 
 /**
  * @brief Frees the memory used by a row (both rendered and actual string)
  * 
+ * @param state (pointer to the editor state object)
  * @param row 
  */
-static void free_row(erow *row) {
-    free(row->render);
-    free(row->chars);
-    free(row->hl);
+static void free_row(eState *state, erow *row) {
+    free_render(row);
+    free_chars(state, row);
+}
+
+/**
+ * @brief Keeps the range of dirty rows in place while rows are inserted
+ *        or removed at @at, during an edit transaction.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (index of the first inserted or removed row)
+ * @param count (number of inserted rows, negative for removed rows)
+ */
+static void shift_dirty(eState *state, int at, int count) {
+    if (state->edits == 0 || state->editlast < state->editfirst)
+        return;
+    if (count > 0) {
+        if (state->editfirst >= at)
+            state->editfirst += count;
+        if (state->editlast >= at)
+            state->editlast += count;
+        return;
+    }
+    int end = at - count;
+    if (state->editfirst >= end)
+        state->editfirst += count;
+    else if (state->editfirst > at)
+        state->editfirst = at;
+    if (state->editlast >= end)
+        state->editlast += count;
+    else if (state->editlast >= at)
+        state->editlast = at - 1;
+}
+
+/**
+ * @brief Builds the render details of an edited row again, or marks it
+ *        dirty while an edit transaction is open.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the edited row)
+ */
+static void update_row(eState *state, erow *row) {
+    if (state->edits == 0) {
+        editorUpdateRow(state, row);
+        return;
+    }
+    ROW_FLAGS(row) |= ROW_DIRTY | ROW_STALE; // editorPrepareRow still builds it on demand
+    int at = editorRowIndex(state, row);
+    if (state->editlast < state->editfirst) {
+        state->editfirst = state->editlast = at;
+    } else if (at < state->editfirst) {
+        state->editfirst = at;
+    } else if (at > state->editlast) {
+        state->editlast = at;
+    }
+}
+
+/**
+ * @brief Lays an edited row out again after a single char was inserted or
+ *        deleted, from the word the edit is in on, up to where the wraps
+ *        fall as before the edit - in an edit transaction as well. Rows not
+ *        rendered yet (or left dirty by the transaction) go through
+ *        update_row.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the edited row)
+ * @param at (index of the inserted char, or of the deleted char before the edit)
+ * @param delta (1 for an inserted char, -1 for a deleted one)
+ * @param removed (the deleted char)
+ */
+static void update_row_edit(eState *state, erow *row, int at, int delta, char removed) {
+    if (ROW_FLAGS(row) & ROW_STALE) {
+        update_row(state, row);
+        return;
+    }
+    wrapLayoutEdit(state, row, at, delta, removed);
+    editorUpdateSyntax(state, row);
+}
+
+/**
+ * @brief Opens a slot for a row at index @at, shifting the following
+ *        rows, and returns it with empty render details.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (insert location - row index)
+ * @return erow* (the new row slot, chars are left unset)
+ */
+static erow *insert_row_slot(eState *state, int at) {
+    shift_dirty(state, at, 1);
+    rowIndexInsert(state->rows, at, 1);
+    erow *row = editorRow(state, at);
+    ROW_WRAPS(row) = 0;
+    row->rd = NULL;
+    row->gap = 0;
+    row->gaplen = 0;
+    ROW_OPEN_COMMENT(row) = 0;
+    ROW_FLAGS(row) = 0;
+    return row;
+}
+
+/**
+ * @brief Moves the gap in the chars of an owned row to @at, shifting the
+ *        text between the old and the new place over it.
+ * 
+ * @param row (the row)
+ * @param at (new start of the gap)
+ */
+static void move_gap(erow *row, int at) {
+    if (row->gaplen > 0 && at < row->gap)
+        memmove(&row->chars[at + row->gaplen], &row->chars[at], row->gap - at);
+    else if (row->gaplen > 0 && at > row->gap)
+        memmove(&row->chars[row->gap], &row->chars[row->gap + row->gaplen], at - row->gap);
+    row->gap = at;
+}
+
+/**
+ * @brief Opens a gap of at least @len bytes at @at in the chars of an owned
+ *        row. A gap too small is closed, and opened again at the end of the
+ *        row with room for more edits, growing the arena slot of the row.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ * @param at (start of the gap)
+ * @param len (least length of the gap)
+ */
+static void open_gap(eState *state, erow *row, int at, int len) {
+    if (row->gaplen < len) {
+        editorRowFlatten(row);
+        int room = len + EDDIE_ROW_GAP + ROW_SIZE(row) / 4;
+        row->chars = editorArenaGrow(state, row->chars, ROW_SIZE(row), ROW_SIZE(row) + room);
+        row->chars[ROW_SIZE(row) + room] = '\0'; // the null-terminator stays right after the text after the gap
+        row->gap = ROW_SIZE(row);
+        row->gaplen = room;
+    }
+    move_gap(row, at);
+}
+
+/**
+ * @brief Width of the numbering column for a number of lines.
+ * 
+ * @param count (number of lines, an empty file is numbered as a single line)
+ * @return int (the width)
+ */
+static int linenum_width(long long count) {
+    if (count < 1)
+        count = 1;
+    return floor(log10(count)) + 2;
+}
+
+/**
+ * @brief Counts a newly inserted row in the editor state.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+static void count_new_row(eState *state) {
+    state->numrows++;
+
+    // only widened, the column may already fit rows that are still being loaded
+    long long total = editorTotalRows(state);
+    if (linenum_width(total) > state->linenum_w)
+        editorSetLineCount(state, total); // the new row overflows the numbering column
+}
+
+/**
+ * @brief Records an edit of row @at - bumps the dirty count, and moves the
+ *        first modified row back to @at, walking the offset of it in the
+ *        file on disk back over the rows in between.
+ *        Once the offset falls in the first half of the file it is no
+ *        longer tracked, as the next save rewrites the whole file anyway.
+ *        The unchanged rows at both ends of the row array are trimmed too,
+ *        so the rows around the edit are not paged out in windowed mode.
+ *        Must be called before the row is changed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (index of the row being changed)
+ */
+static void mark_modified(eState *state, int at) {
+    state->dirty++;
+    editorCacheDrop(state);
+    if (state->winhead > at)
+        state->winhead = at;
+    if (state->wintail > state->numrows - at - 1)
+        state->wintail = (at < state->numrows) ? state->numrows - at - 1 : 0;
+    if (at >= state->modrow)
+        return;
+    for (int j = state->modrow - 1; j >= at && state->modoff != -1; j--) {
+        state->modoff -= editorRowFileLen(state, editorRow(state, j));
+        if (state->modoff * 2 < state->disksize)
+            state->modoff = -1;
+    }
+    state->modrow = at;
 }
 
 /*** row operations ***/
@@ -56,7 +247,7 @@ int editorRowCxToRx(erow *row, int cx) {
     int rx = 0;
     int j;
     for (j = 0; j < cx; j++) {
-        if (row->chars[j] == '\t')
+        if (editorRowChar(row, j) == '\t')
             rx += (EDDIE_TAB_STOP - 1) - (rx % EDDIE_TAB_STOP); // replace tab count with amount of spaces to hit next tab stop
         rx++;
     }
@@ -66,8 +257,8 @@ int editorRowCxToRx(erow *row, int cx) {
 int editorRowRxToCx(erow *row, int rx) {
     int cur_rx = 0;
     int cx;
-    for (cx = 0; cx < row->size; cx++) {
-        if (row->chars[cx] == '\t')
+    for (cx = 0; cx < ROW_SIZE(row); cx++) {
+        if (editorRowChar(row, cx) == '\t')
             cur_rx += (EDDIE_TAB_STOP - 1) - (cur_rx % EDDIE_TAB_STOP);
         cur_rx++;
 
@@ -78,146 +269,314 @@ int editorRowRxToCx(erow *row, int rx) {
 }
 
 void editorUpdateRow(eState *state, erow *row) {
-    // Calculate the number of tabs first, to allocate enoguh memory for render
-    int tabs = 0;
-    int j;
-    for (j = 0; j < row->size; j++)
-        if (row->chars[j] == '\t')
-            tabs++;
-
-    free(row->render);
-    int size = (row->size + tabs * (EDDIE_TAB_STOP - 1)) + 1;
-    row->render = malloc(size);
-    // wrap stops are not taken into accound when allocating render,
-    // which will be reallocated if necessary.
-
-    int idx = 0;
-    int row_idx = 0;
-    row->wraps = 0;
-    row->wrap_stops = malloc(sizeof(int)); // start with single int array
-    row->wrap_stops[0] = state->editcols;
-    for (j = 0; j < row->size; j++) {
-#ifdef DO_SOFTWRAP
-        int to_next_space = distance_to_next_space(row, j);
-        int from_prev_space = distance_from_prev_space(row, j);
-        if ((isspace(row->chars[j]) && // next word will overflow the display
-                row_idx + to_next_space >= state->editcols) ||
-            (row_idx >= state->editcols && // word is too long to avoid breaking
-                from_prev_space >= state->editcols / 2)) {
-            row->wraps++;
-            row->wrap_stops = realloc(row->wrap_stops, row->wraps * sizeof(int));
-            row->wrap_stops[row->wraps - 1] = row_idx;
-            row_idx = 0;
-            size++;
-            row->render = realloc(row->render, size);
-            row->render[idx++] = '\n';
-        }
-#endif /* DO_SOFTWRAP */
-        if (row->chars[j] == '\t') {
-            do {
-                row->render[idx++] = ' ';
-                row_idx++;
-            } while (idx % EDDIE_TAB_STOP != 0);
-        } else {
-            row->render[idx++] = row->chars[j];
-            row_idx++;
-        }
-    }
-#ifdef DO_SOFTWRAP
-    row->wrap_stops = realloc(row->wrap_stops, (row->wraps + 1) * sizeof(int));
-    row->wrap_stops[row->wraps] = row_idx; // set last wrap stop to end of the row
-#endif /* DO_SOFTWRAP */
-    row->render[idx] = '\0';
-    row->rsize = idx;
+    ROW_FLAGS(row) &= ~(ROW_STALE | ROW_DIRTY);
 
+    wrapLayoutRow(state, row);
     editorUpdateSyntax(state, row);
 }
 
-void editorInsertRow(eState *state, int at, char *s, size_t len) {
-    state->row = realloc(state->row, sizeof(erow) * (state->numrows + 1)); // reallocate larger row array
+void editorPrepareRow(eState *state, erow *row) {
+    if ((ROW_FLAGS(row) & ROW_STALE) || row->rd->cols != state->editcols) { // or laid out before the numbering column changed width
+        editorTrimRowMemory(state); // a single command may render many rows, the budget holds while it does
+        editorUpdateRow(state, row);
+    }
+    ROW_FLAGS(row) |= ROW_SEEN;
+}
 
-    if (at != state->numrows) { 
-        // move rows after @at to make place for new row
-        memmove(&state->row[at + 1], &state->row[at], sizeof(erow) * (state->numrows - at));
-        for (int j = at + 1; j <= state->numrows; j++)
-            state->row[j].idx++;
+void editorEditBegin(eState *state) {
+    if (state->edits++ == 0) {
+        state->editfirst = 0;
+        state->editlast = -1; // no dirty rows yet
     }
+}
+
+void editorEditCommit(eState *state) {
+    if (--state->edits > 0)
+        return;
+    if (state->editlast >= state->numrows)
+        state->editlast = state->numrows - 1;
+    for (int j = state->editfirst; j <= state->editlast; j++) {
+        erow *row = editorRow(state, j);
+        if (ROW_FLAGS(row) & ROW_DIRTY)
+            editorUpdateRow(state, row);
+    }
+    state->editfirst = 0;
+    state->editlast = -1;
+}
+
+void editorRowFlatten(erow *row) {
+    if (row->gaplen == 0)
+        return;
+    memmove(&row->chars[row->gap], &row->chars[row->gap + row->gaplen], ROW_SIZE(row) - row->gap);
+    row->chars[ROW_SIZE(row)] = '\0';
+    row->gaplen = 0;
+}
 
-    state->row[at].idx = at;
+void editorRowOwnChars(eState *state, erow *row) {
+    if ((ROW_FLAGS(row) & ROW_SHARED) && state->save == NULL)
+        ROW_FLAGS(row) &= ~ROW_SHARED; // the save that shared the row already finished
+    if (!(ROW_FLAGS(row) & (ROW_MAPPED | ROW_SHARED)))
+        return;
+    if (ROW_FLAGS(row) & ROW_CUT) { // the rest of the line is left behind in the mapping
+        editorSetStatusMessage(state, "A line longer than %d bytes was cut short, the file can't be saved", EDDIE_MAX_ROW);
+        state->cut = 1;
+        ROW_FLAGS(row) &= ~ROW_CUT;
+    }
 
-    state->row[at].size = len;
-    state->row[at].chars = malloc(len + 1); // extra character for null-termination
-    memcpy(state->row[at].chars, s, len);
-    state->row[at].chars[len] = '\0';
+    char *chars = editorArenaNew(state, row->chars, ROW_SIZE(row));
+    if (ROW_FLAGS(row) & ROW_SHARED)
+        editorSaveKeep(state, row->chars); // the save still reads the old copy
+    row->chars = chars;
+    ROW_FLAGS(row) &= ~(ROW_MAPPED | ROW_SHARED);
+}
 
-    state->row[at].rsize = 0;
-    state->row[at].wraps = 0;
-    state->row[at].wrap_stops = NULL;
-    state->row[at].render = NULL;
-    state->row[at].hl = NULL;
-    state->row[at].bg = NULL;
-    state->row[at].hl_open_comment = 0;
-    editorUpdateRow(state, &state->row[at]);
+size_t editorRowFileLen(eState *state, erow *row) {
+    if (ROW_FLAGS(row) & ROW_CUT) // the whole line, from the index of the mapping it is in
+        return lineIndexLen(state->lines, lineIndexFind(state->lines, row->chars - state->map)) + 1;
+    return ROW_SIZE(row) + ((ROW_FLAGS(row) & ROW_CRLF) ? 2 : 1);
+}
 
-    state->numrows++;
+erow *editorRow(eState *state, int at) {
+    return rowIndexGet(state->rows, at);
+}
 
-    // recalculate the numbering column width in case the new row caused its width to overflow
-    int linenum_w = floor(log10(abs(state->numrows))) + 2;
-    if (state->linenum_w < linenum_w) {
-        state->linenum_w = linenum_w;
-        state->editcols = state->screencols - state->linenum_w;
+int editorRowIndex(eState *state, erow *row) {
+    return rowIndexOf(state->rows, row);
+}
+
+void editorInsertRow(eState *state, int at, char *s, size_t len) {
+    editorJournalRecord(state, JOURNAL_INSERT_ROW, at, 0, s, len);
+    mark_modified(state, at);
+    erow *row = insert_row_slot(state, at);
+
+    ROW_SIZE(row) = len;
+    row->chars = editorArenaNew(state, s, len);
+    update_row(state, row);
+
+    count_new_row(state);
+}
+
+int editorRowFit(eState *state, size_t len) {
+    if (len <= EDDIE_MAX_ROW)
+        return len;
+    if (!state->cut)
+        editorSetStatusMessage(state, "A line longer than %d bytes was cut short, the file can't be saved", EDDIE_MAX_ROW);
+    state->cut = 1;
+    return EDDIE_MAX_ROW;
+}
+
+void editorLoadRows(eState *state, int at, char *buf, struct lineidx *idx, long long first, int count) {
+    if (count <= 0)
+        return;
+    shift_dirty(state, at, count);
+    rowIndexInsert(state->rows, at, count);
+    for (int j = 0; j < count; j++) {
+        erow *row = editorRow(state, at + j);
+        size_t len = lineIndexLen(idx, first + j);
+        row->chars = &buf[idx->off[first + j]];
+        ROW_WRAPS(row) = 0;
+        row->rd = NULL;
+        row->gap = 0;
+        row->gaplen = 0;
+        ROW_OPEN_COMMENT(row) = editorCacheCheckpoint(state, first + j); // otherwise calculated along with the render
+        ROW_FLAGS(row) = ROW_MAPPED | ROW_STALE;
+        if (len > 0 && row->chars[len - 1] == '\r') {
+            len--;
+            ROW_FLAGS(row) |= ROW_CRLF;
+        }
+        if (len > EDDIE_MAX_ROW && state->lines != NULL) { // the rest is saved from the mapping, see editorRowFileLen
+            editorSetStatusMessage(state, "A line longer than %d bytes is cut short, it can't be edited", EDDIE_MAX_ROW);
+            len = EDDIE_MAX_ROW;
+            ROW_FLAGS(row) |= ROW_CUT;
+        }
+        ROW_SIZE(row) = editorRowFit(state, len);
     }
 
-    state->dirty++;
+    // the loaded rows are unchanged - they extend the unchanged rows they are next to
+    if (at <= state->winhead)
+        state->winhead += count;
+    if (at >= state->numrows - state->wintail)
+        state->wintail += count;
+    if (at < state->modrow || (at == state->modrow && at < state->numrows))
+        state->modrow += count;
+    state->numrows += count;
+}
+
+void editorDropRows(eState *state, int at, int count) {
+    if (count <= 0)
+        return;
+    int end = at + count;
+    int tailstart = state->numrows - state->wintail;
+    if (state->winhead > at) // dropped rows from the unchanged head
+        state->winhead -= (state->winhead < end ? state->winhead : end) - at;
+    if (end > tailstart) // dropped rows from the unchanged tail
+        state->wintail -= end - (tailstart > at ? tailstart : at);
+    if (state->modrow >= end) {
+        state->modrow -= count;
+    } else if (state->modrow > at) { // the rows were unchanged on disk too
+        for (int j = at; j < state->modrow && state->modoff != -1; j++)
+            state->modoff -= editorRowFileLen(state, editorRow(state, j));
+        state->modrow = at;
+    }
+
+    for (int j = at; j < end; j++) {
+        free_render(editorRow(state, j));
+        free_chars(state, editorRow(state, j));
+    }
+    shift_dirty(state, at, -count);
+    rowIndexRemove(state->rows, at, count);
+    state->numrows -= count;
+}
+
+void editorUnprepareRow(eState *state, erow *row) {
+    if (ROW_FLAGS(row) & ROW_STALE)
+        return;
+    editorRowFlatten(row); // rows not rendered are scanned as one string
+    free_render(row);
+    wrapClear(state, row);
+    ROW_FLAGS(row) |= ROW_STALE;
 }
 
 void editorDelRow(eState *state, int at) {
     if (at < 0 || at >= state->numrows)
         return; // illegal delete location
-    free_row(&state->row[at]);
-    // move all the remaining rows one backwards
-    memmove(&state->row[at], &state->row[at + 1], sizeof(erow) * (state->numrows - at - 1));
-    for (int j = at; j <= state->numrows - 1; j++)
-        state->row[j].idx--;
+    editorJournalRecord(state, JOURNAL_DEL_ROW, at, 0, NULL, 0);
+    mark_modified(state, at);
+    free_row(state, editorRow(state, at));
+    shift_dirty(state, at, -1);
+    rowIndexRemove(state->rows, at, 1);
     state->numrows--;
 
-    // recalculate the numbering column width in case the deleted row allows it to be narrower
-    int linenum_w = floor(log10(abs(state->numrows))) + 2;
-    if (state->linenum_w > linenum_w) {
-        state->linenum_w = linenum_w;
-        state->editcols = state->screencols - state->linenum_w;
-    }
-
-    state->dirty++;
+    long long total = editorTotalRows(state);
+    if (linenum_width(total) < state->linenum_w)
+        editorSetLineCount(state, total); // the deleted row allows a narrower numbering column
 }
 
 void editorRowInsertChar(eState *state, erow *row, int at, int c) {
-    if (at < 0 || at > row->size)
-        at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1); // move leftover row to make place for new char
-    row->size++;
-    row->chars[at] = c;
-    editorUpdateRow(state, row);
-    state->dirty++;
+    if (at < 0 || at > ROW_SIZE(row))
+        at = ROW_SIZE(row);
+    char ch = c;
+    int idx = editorRowIndex(state, row);
+    editorJournalRecord(state, JOURNAL_INSERT_CHAR, idx, at, &ch, 1);
+    mark_modified(state, idx);
+    editorRowOwnChars(state, row);
+    open_gap(state, row, at, 1);
+    row->chars[row->gap++] = c;
+    row->gaplen--;
+    ROW_SIZE(row)++;
+    update_row_edit(state, row, at, 1, 0);
 }
 
 void editorRowAppendString(eState *state, erow *row, char *s, size_t len) {
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(state, row);
-    state->dirty++;
+    int idx = editorRowIndex(state, row);
+    editorJournalRecord(state, JOURNAL_APPEND_STRING, idx, 0, s, len);
+    mark_modified(state, idx);
+    editorRowOwnChars(state, row);
+    open_gap(state, row, ROW_SIZE(row), len);
+    memcpy(&row->chars[row->gap], s, len);
+    row->gap += len;
+    row->gaplen -= len;
+    ROW_SIZE(row) += len;
+    update_row(state, row);
+}
+
+void editorRowTruncate(eState *state, erow *row, int at) {
+    if (at < 0 || at >= ROW_SIZE(row))
+        return; // nothing to cut
+    int idx = editorRowIndex(state, row);
+    editorJournalRecord(state, JOURNAL_TRUNCATE, idx, at, NULL, 0);
+    mark_modified(state, idx);
+    if (!(ROW_FLAGS(row) & ROW_MAPPED)) { // mapped rows are bounded by their size alone
+        editorRowOwnChars(state, row);
+        move_gap(row, at);
+        row->gaplen += ROW_SIZE(row) - at; // the cut text joins the gap
+    }
+    ROW_SIZE(row) = at;
+    ROW_FLAGS(row) &= ~ROW_CUT; // the rest of a line cut short goes as well
+    update_row(state, row);
+}
+
+void editorRowSetCrlf(eState *state, erow *row, int crlf) {
+    if (!(ROW_FLAGS(row) & ROW_CRLF) == !crlf)
+        return; // the line ending is unchanged
+    int idx = editorRowIndex(state, row);
+    editorJournalRecord(state, JOURNAL_CRLF, idx, crlf != 0, NULL, 0);
+    mark_modified(state, idx);
+    ROW_FLAGS(row) ^= ROW_CRLF;
 }
 
 void editorRowDelChar(eState *state, erow *row, int at) {
-    if (at < 0 || at >= row->size)
+    if (at < 0 || at >= ROW_SIZE(row))
         return; // illegal delete location
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at); // move the rest of the row and override the deleted char
-    row->size--;
-    editorUpdateRow(state, row);
-    state->dirty++;
+    int idx = editorRowIndex(state, row);
+    editorJournalRecord(state, JOURNAL_DEL_CHAR, idx, at, NULL, 0);
+    mark_modified(state, idx);
+    editorRowOwnChars(state, row);
+    char removed = editorRowChar(row, at);
+    move_gap(row, at);
+    row->gaplen++; // the deleted char joins the gap
+    ROW_SIZE(row)--;
+    update_row_edit(state, row, at, -1, removed);
+}
+
+void editorSetLineCount(eState *state, long long count) {
+    int linenum_w = linenum_width(count);
+    if (state->linenum_w != linenum_w) {
+        state->linenum_w = linenum_w;
+        state->editcols = state->screencols - state->linenum_w;
+    }
+}
+
+void editorShowRowMemory(eState *state) {
+    struct slabStats stats;
+    slabGetStats(&stats);
+    char reserved[16], used[16];
+    editorFormatSize(reserved, sizeof(reserved), stats.reserved);
+    editorFormatSize(used, sizeof(used), stats.used);
+    int fragmented = stats.reserved ? (stats.reserved - stats.used) * 100 / stats.reserved : 0;
+    editorSetStatusMessage(state, "Row memory: %s in %zu slabs, %s in use (%d%% fragmented)", reserved,
+                           stats.slabs, used, fragmented);
+}
+
+void editorTrimRowMemory(eState *state) {
+    struct slabStats stats;
+    slabGetStats(&stats);
+    if (stats.used <= state->rowbudget) {
+        state->trimfloor = 0; // freed or unloaded rows brought it back within the budget
+        state->trimswept = 0;
+        return;
+    }
+    if (stats.used <= state->trimfloor || state->numrows == 0)
+        return;
+
+    size_t target = state->rowbudget - state->rowbudget / 4;
+    for (int steps = EDDIE_TRIM_STEPS; steps > 0 && stats.used > target; steps--) {
+        if (state->trimhand >= state->numrows)
+            state->trimhand = 0;
+        int at = state->trimhand++;
+        state->trimswept++;
+        erow *row = editorRow(state, at);
+        if (ROW_FLAGS(row) & ROW_STALE)
+            continue; // nothing to free
+        if (ROW_FLAGS(row) & ROW_SEEN) { // displayed since the last sweep - kept for now
+            ROW_FLAGS(row) &= ~ROW_SEEN;
+            continue;
+        }
+        if ((at >= state->rowoff - 1 && at <= state->rowoff + state->editrows) ||
+            (at >= state->cy - state->editrows && at <= state->cy + state->editrows))
+            continue; // displayed, or within a screen of the cursor (which may not be displayed yet)
+        editorUnprepareRow(state, row);
+        slabGetStats(&stats);
+    }
+    if (stats.used <= target) {
+        state->trimswept = 0;
+        return;
+    }
+    if (state->trimswept < 2LL * state->numrows)
+        return; // every row gets its second chance before the sweep gives up, the next calls go on with it
+    // the rows left are in use - sweep again only once more were rendered
+    state->trimswept = 0;
+    state->trimfloor = stats.used + state->rowbudget / 4;
 }
 
 /** append buffer ***/
@@ -0,0 +1,358 @@
+#include "syshead.h"
+
+#include "cache.h"
+#include "buffer.h"
+#include "consts.h"
+#include "lineidx.h"
+#include "rowidx.h"
+#include "structs.h"
+
+/**
+ * @brief The start of a cache entry, followed by the path of the file, the
+ *        line offsets and the comment checkpoints.
+ *
+ * {
+ *      char magic[8]; (always "EDDIEC2\n")
+ *      off_t size; (size of the file)
+ *      time_t mtime; (modification time of the file, seconds)
+ *      long mtime_nsec; (modification time of the file, nanoseconds)
+ *      long long count; (number of lines in the index)
+ *      int interval; (lines between two checkpoints)
+ *      int checkpoints; (number of checkpoints)
+ *      int pathlen; (length of the path)
+ *      char filetype[16]; (syntax the checkpoints were highlighted with)
+ * }
+ */
+struct cacheHeader {
+    char magic[8];
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+    long long count;
+    int interval;
+    int checkpoints;
+    int pathlen;
+    char filetype[16];
+};
+
+/**
+ * @brief The cache entry of the open file.
+ *
+ * {
+ *      char *path; (path of the entry)
+ *      struct cacheHeader hdr; (the header of the entry)
+ *      signed char *checkpoints; (comment state at the end of every interval-th line)
+ * }
+ */
+struct fileCache {
+    char *path;
+    struct cacheHeader hdr;
+    signed char *checkpoints;
+};
+
+/**
+ * @brief A cache entry being written while the file is indexed.
+ *
+ * {
+ *      char *path; (path of the entry)
+ *      char *tmp; (temporary file the entry is written to)
+ *      int cfd; (descriptor of the temporary file)
+ *      struct cacheHeader hdr; (the header of the entry)
+ *      long long written; (number of line offsets written so far)
+ *      int ok; (whether all the writes so far succeeded)
+ * }
+ */
+struct cacheWriter {
+    char *path;
+    char *tmp;
+    int cfd;
+    struct cacheHeader hdr;
+    long long written;
+    int ok;
+};
+
+/**
+ * @brief Absolute path of a file, the key of its cache entry.
+ *
+ * @param filename (path of the file)
+ * @return char* (the key, should be freed)
+ */
+static char *cache_key(const char *filename) {
+    char *key = realpath(filename, NULL);
+    return key ? key : strdup(filename);
+}
+
+/**
+ * @brief Path of the cache entry of a file - named after a hash of its key,
+ *        in the cache directory (which is created if needed).
+ *
+ * @param key (the key of the file)
+ * @return char* (path of the entry, NULL if there is no cache directory)
+ */
+static char *cache_path(const char *key) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+    if (base != NULL && *base != '\0') {
+        snprintf(dir, sizeof(dir), "%s", base);
+    } else if (home != NULL && *home != '\0') {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+        mkdir(dir, 0700);
+    } else {
+        return NULL;
+    }
+    size_t len = strlen(dir);
+    snprintf(&dir[len], sizeof(dir) - len, "/eddie");
+    if (mkdir(dir, 0700) == -1 && errno != EEXIST)
+        return NULL;
+
+    unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+    for (const char *c = key; *c; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+    char *path = malloc(strlen(dir) + 18);
+    sprintf(path, "%s/%016llx", dir, hash);
+    return path;
+}
+
+/**
+ * @brief Fills in the cache header for the open file as it is on disk now.
+ *
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param key (the key of the file)
+ * @param hdr (the header filled in)
+ * @return int (returns -1 if the file can't be accessed, otherwise 0)
+ */
+static int file_header(eState *state, int fd, const char *key, struct cacheHeader *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -1;
+    memcpy(hdr->magic, "EDDIEC2\n", sizeof(hdr->magic));
+    hdr->size = st.st_size;
+    hdr->mtime = st.st_mtim.tv_sec;
+    hdr->mtime_nsec = st.st_mtim.tv_nsec;
+    hdr->interval = EDDIE_CACHE_CHECKPOINT;
+    hdr->pathlen = strlen(key);
+    if (state->syntax)
+        snprintf(hdr->filetype, sizeof(hdr->filetype), "%s", state->syntax->filetype);
+    return 0;
+}
+
+/**
+ * @brief Checks whether a cache entry is for the given version of a file.
+ *
+ * @param cfd (descriptor of the entry)
+ * @param want (header of the file as it is on disk now)
+ * @param key (the key of the file)
+ * @param hdr (set to the header of the entry)
+ * @return int (whether the entry is for the file)
+ */
+static int entry_matches(int cfd, struct cacheHeader *want, const char *key, struct cacheHeader *hdr) {
+    if (pread(cfd, hdr, sizeof(*hdr), 0) != sizeof(*hdr))
+        return 0;
+    if (memcmp(hdr->magic, want->magic, sizeof(hdr->magic)) != 0 || hdr->size != want->size ||
+        hdr->mtime != want->mtime || hdr->mtime_nsec != want->mtime_nsec || hdr->pathlen != want->pathlen ||
+        hdr->count < 0 || hdr->checkpoints < 0)
+        return 0;
+
+    char *path = malloc(hdr->pathlen);
+    int same = (pread(cfd, path, hdr->pathlen, sizeof(*hdr)) == hdr->pathlen &&
+                memcmp(path, key, hdr->pathlen) == 0); // not another file with the same hash
+    free(path);
+    return same;
+}
+
+int editorCacheLoad(eState *state, int fd, struct lineidx *idx) {
+    char *key = cache_key(state->filename);
+    char *path = cache_path(key);
+    struct cacheHeader want, hdr;
+    int cfd = -1;
+    if (path != NULL && file_header(state, fd, key, &want) == 0)
+        cfd = open(path, O_RDONLY);
+    if (cfd == -1 || !entry_matches(cfd, &want, key, &hdr)) {
+        if (cfd != -1)
+            close(cfd);
+        free(key);
+        free(path);
+        return -1;
+    }
+
+    off_t offset = sizeof(hdr) + hdr.pathlen;
+    int err = lineIndexRead(idx, cfd, offset, hdr.count);
+    if (err == 0 && (idx->off[0] != 0 || idx->off[hdr.count] < (size_t)hdr.size ||
+                     idx->off[hdr.count] > (size_t)hdr.size + 1))
+        err = -1; // not the index of a file this size
+    signed char *checkpoints = NULL;
+    if (err == 0 && hdr.checkpoints > 0 && hdr.interval == want.interval &&
+        strncmp(hdr.filetype, want.filetype, sizeof(hdr.filetype)) == 0) {
+        checkpoints = malloc(hdr.checkpoints);
+        offset += sizeof(size_t) * (hdr.count + 1);
+        if (pread(cfd, checkpoints, hdr.checkpoints, offset) != hdr.checkpoints) {
+            free(checkpoints);
+            checkpoints = NULL;
+        }
+    }
+    close(cfd);
+    free(key);
+    if (err == -1) {
+        idx->count = 0;
+        free(path);
+        return -1;
+    }
+    if (checkpoints == NULL)
+        hdr.checkpoints = 0;
+
+    struct fileCache *cache = malloc(sizeof(struct fileCache));
+    cache->path = path;
+    cache->hdr = hdr;
+    cache->checkpoints = checkpoints;
+    state->cache = cache;
+    return 0;
+}
+
+struct cacheWriter *editorCacheWriteStart(eState *state, int fd) {
+    char *key = cache_key(state->filename);
+    char *path = cache_path(key);
+    struct cacheHeader hdr;
+    if (path == NULL || file_header(state, fd, key, &hdr) == -1) {
+        free(key);
+        free(path);
+        return NULL;
+    }
+
+    // written to a temporary file first, so other editors never read half an entry
+    size_t tmplen = strlen(path) + sizeof(".XXXXXX");
+    char *tmp = malloc(tmplen);
+    snprintf(tmp, tmplen, "%s.XXXXXX", path);
+    int cfd = mkstemp(tmp);
+    if (cfd == -1 || pwrite(cfd, key, hdr.pathlen, sizeof(hdr)) != hdr.pathlen) {
+        if (cfd != -1) {
+            close(cfd);
+            unlink(tmp);
+        }
+        free(tmp);
+        free(key);
+        free(path);
+        return NULL;
+    }
+    free(key);
+
+    struct cacheWriter *w = malloc(sizeof(struct cacheWriter));
+    w->path = path;
+    w->tmp = tmp;
+    w->cfd = cfd;
+    w->hdr = hdr;
+    w->written = 0;
+    w->ok = 1;
+    return w;
+}
+
+void editorCacheWriteLines(struct cacheWriter *w, struct lineidx *chunk, size_t base) {
+    if (w == NULL || !w->ok)
+        return;
+
+    size_t buf[4096];
+    off_t offset = sizeof(w->hdr) + w->hdr.pathlen + sizeof(size_t) * w->written;
+    long long j = (w->written == 0) ? 0 : 1; // the first offset of a chunk ends the lines before it
+    while (j <= chunk->count) {
+        size_t n = 0;
+        while (n < sizeof(buf) / sizeof(buf[0]) && j <= chunk->count)
+            buf[n++] = base + chunk->off[j++];
+        if (pwrite(w->cfd, buf, sizeof(size_t) * n, offset) != (ssize_t)(sizeof(size_t) * n)) {
+            w->ok = 0;
+            return;
+        }
+        offset += sizeof(size_t) * n;
+        w->written += n;
+    }
+}
+
+void editorCacheWriteEnd(struct cacheWriter *w, int fd) {
+    if (w == NULL)
+        return;
+
+    struct stat st;
+    if (w->ok)
+        w->ok = (fstat(fd, &st) == 0 && st.st_size == w->hdr.size && st.st_mtim.tv_sec == w->hdr.mtime &&
+                 st.st_mtim.tv_nsec == w->hdr.mtime_nsec); // the index is of the file as it was opened
+    w->hdr.count = w->written - 1;
+    // the header goes last, the entry only counts once the offsets are all written
+    if (w->ok)
+        w->ok = (w->written > 0 && pwrite(w->cfd, &w->hdr, sizeof(w->hdr), 0) == sizeof(w->hdr) &&
+                 rename(w->tmp, w->path) == 0);
+    close(w->cfd);
+    if (!w->ok)
+        unlink(w->tmp);
+}
+
+void editorCacheWriteAdopt(eState *state, struct cacheWriter *w) {
+    if (w == NULL)
+        return;
+    free(w->tmp);
+    if (!w->ok) {
+        free(w->path);
+        free(w);
+        return;
+    }
+
+    struct fileCache *cache = malloc(sizeof(struct fileCache));
+    cache->path = w->path;
+    cache->hdr = w->hdr;
+    cache->checkpoints = NULL;
+    if (state->syntax) // only known now, the checkpoints added on close are highlighted with it
+        snprintf(cache->hdr.filetype, sizeof(cache->hdr.filetype), "%s", state->syntax->filetype);
+    state->cache = cache;
+    free(w);
+}
+
+int editorCacheCheckpoint(eState *state, long long line) {
+    struct fileCache *cache = state->cache;
+    if (cache == NULL || (line + 1) % EDDIE_CACHE_CHECKPOINT != 0)
+        return -1;
+    long long k = (line + 1) / EDDIE_CACHE_CHECKPOINT - 1;
+    return (k < cache->hdr.checkpoints) ? cache->checkpoints[k] : -1;
+}
+
+void editorCacheDrop(eState *state) {
+    struct fileCache *cache = state->cache;
+    if (cache == NULL)
+        return;
+    free(cache->path);
+    free(cache->checkpoints);
+    free(cache);
+    state->cache = NULL;
+}
+
+void editorCacheClose(eState *state) {
+    struct fileCache *cache = state->cache;
+    if (cache == NULL)
+        return;
+
+    // only the rows from the start of the file up to the first one never highlighted are known
+    int n = 0;
+    if (state->winfirst == 0 && state->syntax && state->syntax->multiline_comment_start) {
+        int last;
+        while ((last = (n + 1) * EDDIE_CACHE_CHECKPOINT - 1) < state->numrows &&
+               ROW_OPEN_COMMENT(editorRow(state, last)) != -1)
+            n++;
+    }
+    struct cacheHeader hdr;
+    int cfd = (n > cache->hdr.checkpoints) ? open(cache->path, O_WRONLY) : -1;
+    if (cfd != -1) {
+        signed char *checkpoints = malloc(n);
+        for (int k = 0; k < n; k++)
+            checkpoints[k] = ROW_OPEN_COMMENT(editorRow(state, (k + 1) * EDDIE_CACHE_CHECKPOINT - 1));
+        hdr = cache->hdr;
+        hdr.checkpoints = n;
+        off_t offset = sizeof(hdr) + hdr.pathlen + sizeof(size_t) * (hdr.count + 1);
+        // the header goes last, the entry only counts the checkpoints once they are all written
+        if (pwrite(cfd, checkpoints, n, offset) == n)
+            pwrite(cfd, &hdr, sizeof(hdr), 0);
+        free(checkpoints);
+        close(cfd);
+    }
+    editorCacheDrop(state);
+}
@@ -4,7 +4,35 @@
 #include "consts.h"
 #include "editor.h"
 #include "file.h"
+#include "follow.h"
+#include "journal.h"
+#include "rowidx.h"
 #include "terminal.h"
+#include "window.h"
+
+/**
+ * @brief The budget of the render details of the rows, from the
+ *        EDDIE_ROW_MEMORY environment variable - a number of bytes, or of
+ *        K, M or G bytes with that suffix.
+ * 
+ * @return size_t (the budget, EDDIE_ROW_MEMORY_BUDGET if the variable is not set or not valid)
+ */
+static size_t row_budget() {
+    const char *value = getenv("EDDIE_ROW_MEMORY");
+    if (value == NULL || !isdigit((unsigned char)value[0]))
+        return EDDIE_ROW_MEMORY_BUDGET;
+    char *end;
+    unsigned long long budget = strtoull(value, &end, 10);
+    const char *units = "KMG";
+    const char *unit = (*end != '\0') ? strchr(units, toupper((unsigned char)*end)) : NULL;
+    if (unit != NULL) {
+        budget <<= 10 * (unit - units + 1);
+        end++;
+    }
+    if (*end != '\0' || budget == 0)
+        return EDDIE_ROW_MEMORY_BUDGET;
+    return budget;
+}
 
 eState *initEditor() {
     eState *state = malloc(sizeof(eState));
@@ -18,12 +46,39 @@ eState *initEditor() {
     state->coloff = 0;
     state->linenum_w = 2;
     state->numrows = 0;
-    state->row = NULL;
+    state->rows = calloc(1, sizeof(struct rowidx)); // an empty row index
+    state->map = NULL;
+    state->mapsize = 0;
+    state->map_current = 0;
+    state->gzip = 0;
+    state->lines = NULL;
+    state->winfirst = 0;
+    state->winlast = 0;
+    state->winhead = 0;
+    state->wintail = 0;
     state->dirty = 0;
+    state->modrow = 0;
+    state->modoff = -1;
+    state->disksize = 0;
+    state->cut = 0;
     state->filename = NULL;
     state->statusmsg[0] = '\0';
     state->statusmsg_time = 0;
     state->syntax = NULL;
+    state->save = NULL;
+    state->follow = NULL;
+    state->journal = NULL;
+    state->input = NULL;
+    state->cache = NULL;
+    state->load = NULL;
+    state->arena = NULL;
+    state->edits = 0;
+    state->editfirst = 0;
+    state->editlast = -1;
+    state->rowbudget = row_budget();
+    state->trimhand = 0;
+    state->trimswept = 0;
+    state->trimfloor = 0;
 
     if (getWindowSize(&state->screenrows, &state->screencols) == -1)
         die("getWindowSize");
@@ -35,16 +90,33 @@ eState *initEditor() {
 
 int main(int argc, char *argv[]) {
     eState *state;
+    int follow = (argc >= 3 && strcmp(argv[1], "-f") == 0); // eddie -f <file> follows the file like tail -f
+    char *filename = (argc >= 2 + follow) ? argv[1 + follow] : NULL;
+    int input = -1;
+    if (filename != NULL && strcmp(filename, "-") == 0) { // cmd | eddie - reads the rows from the pipe
+        input = editorStdinFromTty();
+        if (input == -1) {
+            fprintf(stderr, "usage: cmd | eddie - (standard input is a terminal, not a pipe)\n");
+            return 1;
+        }
+    }
 
     enableRawMode();
     state = initEditor();
-    if (argc >= 2) {
-        editorOpen(state, argv[1]);
+    // set first, so anything opening the file has to report replaces it
+    editorSetStatusMessage(state, "HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-T = follow");
+    if (input != -1) {
+        editorOpenPipe(state, input);
+    } else if (filename != NULL) {
+        editorOpen(state, filename);
     }
 
-    editorSetStatusMessage(state, "HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
+    editorJournalOpen(state); // recovers the edits of a session that didn't quit
+    if (follow)
+        editorFollowToggle(state);
 
     while (1) {
+        editorWindowFollow(state); // page rows in and out around the cursor
         editorRefreshScreen(state);
         editorProcessKeypress(state);
     }
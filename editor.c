@@ -3,26 +3,54 @@
 #include "editor.h"
 #include "buffer.h"
 #include "consts.h"
+#include "file.h"
+#include "rowidx.h"
 #include "terminal.h"
 
 /*** editor operations ***/
 
+/**
+ * @brief Checks whether a row can be edited - a row cut short (ROW_CUT)
+ *        holds only the start of its line, the rest stays in the mapping.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row about to be edited)
+ * @return int (whether the row can be edited, a message is shown if not)
+ */
+static int can_edit(eState *state, erow *row) {
+    if (!(ROW_FLAGS(row) & ROW_CUT))
+        return 1;
+    editorSetStatusMessage(state, "Can't edit a line longer than %d bytes", EDDIE_MAX_ROW);
+    return 0;
+}
+
 void editorInsertChar(eState *state, int c) {
-    if (state->cy == state->numrows) { // cursor is on eof -> insert empty row first
+    editorLoadWait(state); // edits go into the rows of the whole file
+    int eof = (state->cy == state->numrows);
+    if (!eof && !can_edit(state, editorRow(state, state->cy)))
+        return;
+    if (eof) { // cursor is on eof -> insert empty row first, rendered once along with the char
+        editorEditBegin(state);
         editorInsertRow(state, state->numrows, "", 0); 
     }
-    erow *row = &state->row[state->cy];
+    erow *row = editorRow(state, state->cy);
     editorRowInsertChar(state, row, state->cx, c);
+    if (eof)
+        editorEditCommit(state);
     editorMoveCursor(state, ARROW_RIGHT); // advance cursor to after new char
 }
 
 void editorInsertNewLine(eState *state) {
+    editorLoadWait(state);
+    if (state->cx > 0 && !can_edit(state, editorRow(state, state->cy)))
+        return; // the line would be split
     int at = (state->cx == 0) ? state->cy : state->cy + 1;
     int i = 0;
     char *s;
     if (at > 0) { // add indent matching to previous line
-        erow *row = &state->row[at - 1];
-        s = malloc(row->size + 1);
+        erow *row = editorRow(state, at - 1);
+        editorRowFlatten(row);
+        s = malloc(ROW_SIZE(row) + 1);
         while (i < state->cx && 
                 (row->chars[i] == '\t' || row->chars[i] == ' ')) {
             s[i] = row->chars[i];
@@ -33,62 +61,53 @@ void editorInsertNewLine(eState *state) {
     }
     s[i] = '\0';
     
+    editorEditBegin(state); // the split rows are rendered once, after all of it
     if (state->cx == 0) {
         editorInsertRow(state, state->cy, s, i); // insert empty row (possibly with indent)
     } else {
-        erow *row = &state->row[state->cy];
-        ssize_t size = row->size - state->cx + sizeof(s) + 1; // size of leftovers + indent + nullbyte
+        erow *row = editorRow(state, state->cy);
+        editorRowFlatten(row);
+        ssize_t size = ROW_SIZE(row) - state->cx + sizeof(s) + 1; // size of leftovers + indent + nullbyte
         s = realloc(s, size);
-        memcpy(&s[i], &row->chars[state->cx], row->size - state->cx);
-        editorInsertRow(state, state->cy + 1, s, row->size - state->cx + i);
-        row = &state->row[state->cy];
-        row->size = state->cx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(state, row);
+        memcpy(&s[i], &row->chars[state->cx], ROW_SIZE(row) - state->cx);
+        editorInsertRow(state, state->cy + 1, s, ROW_SIZE(row) - state->cx + i);
+        row = editorRow(state, state->cy);
+        editorRowTruncate(state, row, state->cx);
     }
     free(s);
-    // Move cursor accross the added indentation + small trick to make sure cursor lands 
-    // correctly when inserting on edge of wrap
-    if (state->cy == 0 && state->cy == state->cx) {
-        editorStepCursor(state, ARROW_RIGHT, i + 1);
-    } else {
-        editorMoveCursor(state, ARROW_LEFT);
-        editorStepCursor(state, ARROW_RIGHT, i + 2);
-    }
+    // the new line keeps the line ending of the line it was split from (or of the last line, at the end of the file)
+    int from = (at == state->cy) ? at + 1 : state->cy;
+    if (from == state->numrows)
+        from = at - 1;
+    if (from >= 0)
+        editorRowSetCrlf(state, editorRow(state, at), ROW_FLAGS(editorRow(state, from)) & ROW_CRLF);
+    editorEditCommit(state);
+    editorSetCursor(state, state->cy + 1, i); // after the added indentation
 }
 
 void editorDelChar(eState *state) {
+    editorLoadWait(state);
     // Illegal delete locations
     if (state->cy == state->numrows)
         return;
     if (state->cx == 0 && state->cy == 0)
         return;
 
-    erow *row = &state->row[state->cy];
+    erow *row = editorRow(state, state->cy);
+    if (!can_edit(state, row) || (state->cx == 0 && !can_edit(state, editorRow(state, state->cy - 1))))
+        return;
     if (state->cx > 0) {
-#ifdef DO_SOFTWRAP
-        int prev_wraps = row->wraps;
-#endif /* DO_SOFTWRAP */
         editorRowDelChar(state, row, state->cx - 1);
-        editorMoveCursor(state, ARROW_LEFT); // adjust the cursor
-#ifdef DO_SOFTWRAP
-        if (row->wraps < prev_wraps) { // editorUpdateRow was called on DelChar so wraps will be updated
-            state->wrapoff--;
-            state->iy = recalcIy(state);
-            state->ix = recalcIx(state);
-        }
-#endif /* DO_SOFTWRAP */
-        if (state->cx + state->ix == 0 && !(state->cy == 0 && state->cx == state->cy)) {
-            // Move cursor left and right to make sure it is rendered on
-            // end of the row and not start of next row, in case of wraps.
-            editorMoveCursor(state, ARROW_LEFT);
-            editorMoveCursor(state, ARROW_RIGHT);
-        }
+        editorSetCursor(state, state->cy, state->cx - 1); // on the wraps laid out after the edit
     } else { // deleting on start of row, merge with previous row
-        erow *prev_row = &state->row[state->cy - 1];
+        erow *prev_row = editorRow(state, state->cy - 1);
         int del_row = state->cy;
-        editorMoveCursor(state, ARROW_LEFT);
-        editorRowAppendString(state, prev_row, row->chars, row->size);
+        int cx = ROW_SIZE(prev_row);
+        editorEditBegin(state);
+        editorRowFlatten(row);
+        editorRowAppendString(state, prev_row, row->chars, ROW_SIZE(row));
         editorDelRow(state, del_row);
+        editorEditCommit(state);
+        editorSetCursor(state, del_row - 1, cx); // where the rows were joined
     }
 }
\ No newline at end of file
@@ -2,59 +2,867 @@
 
 #include "file.h"
 #include "buffer.h"
+#include "cache.h"
 #include "consts.h"
 #include "structs.h"
 #include "highlight.h"
+#include "lineidx.h"
+#include "rowidx.h"
+#include "arena.h"
 #include "terminal.h"
+#include "window.h"
+#include "follow.h"
+#include "journal.h"
 
 /**
- * @brief Counts the number of lines in the file. The function assumes the pointer is to
- *        beginning of file, and will rewind to the beginning before returning.
+ * @brief Rows being read from a pipe as the data arrives.
  * 
- * @param fp (pointer to the open file. Assumed to point to the start of the file)
- * @return int (number of lines counted)
+ * {
+ *      int fd; (the read end of the pipe, non-blocking)
+ *      struct abuf partial; (the start of the line being read - its newline didn't arrive yet)
+ * }
  */
-static int count_lines(FILE *fp) {
-    int line_count = 0;
-    char *line = NULL;
-    size_t linecap = 0;
+struct pipeInput {
+    int fd;
+    struct abuf partial;
+};
 
-    while (getline(&line, &linecap, fp) != -1) {
-        line_count++;
+/**
+ * @brief A background save - a snapshot of the row contents, and the
+ *        result of writing it, filled in by the writer thread.
+ * 
+ * {
+ *      pthread_t thread; (the writer thread)
+ *      pthread_mutex_t lock; (guards done and the results)
+ *      int done; (whether the writer thread finished)
+ *      char *filename; (path being saved to)
+ *      int tail; (whether only the modified tail of the file is rewritten, in place)
+ *      int gzip; (whether the snapshot is written gzip compressed)
+ *      off_t offset; (file offset the snapshot starts at - 0 unless saving the tail)
+ *      struct iovec *regions; (snapshot of the file contents, pointing at the row storage)
+ *      int nregions; (number of regions in the snapshot)
+ *      int regcap; (number of regions allocated)
+ *      int dirty; (the editor dirty count when the snapshot was taken)
+ *      off_t journal; (end of the edit journal when the snapshot was taken)
+ *      char **keep; (row storage replaced since the snapshot, released once the save finishes)
+ *      int nkeep; (number of kept storage pointers)
+ *      int keepcap; (number of kept storage pointers allocated)
+ *      ssize_t written; (bytes written, -1 on failure)
+ *      int err; (errno of the failure)
+ *      double secs; (time the write took)
+ * }
+ */
+struct saveJob {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int done;
+    char *filename;
+    int tail;
+    int gzip;
+    off_t offset;
+    struct iovec *regions;
+    int nregions;
+    int regcap;
+    int dirty;
+    off_t journal;
+    char **keep;
+    int nkeep;
+    int keepcap;
+    ssize_t written;
+    int err;
+    double secs;
+};
+
+/**
+ * @brief A mapped file loading in the background - the loader thread
+ *        indexes it chunk by chunk, the indexed lines are handed over to
+ *        the editor whenever it's idle.
+ * 
+ * {
+ *      pthread_t thread; (the loader thread)
+ *      pthread_mutex_t lock; (guards pending, scanned and done)
+ *      int done; (whether the loader thread finished)
+ *      struct lineidx pending; (lines indexed but not handed over yet)
+ *      size_t scanned; (bytes indexed so far)
+ *      char *map; (the file mapping)
+ *      size_t size; (size of the file)
+ *      int window; (whether the file is open in windowed mode)
+ *      int fd; (the file, kept to check it didn't change before caching its index)
+ *      struct cacheWriter *cache; (the cache entry the index is written to, NULL if none)
+ *      size_t loaded; (bytes handed over so far)
+ *      struct lineidx own; (index of the handed over lines, unless the window index keeps them)
+ *      struct lineidx *lines; (the index the handed over lines go to - own or the window index)
+ * }
+ */
+struct fileLoader {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int done;
+    struct lineidx pending;
+    size_t scanned;
+    char *map;
+    size_t size;
+    int window;
+    int fd;
+    struct cacheWriter *cache;
+    size_t loaded;
+    struct lineidx own;
+    struct lineidx *lines;
+};
+
+/**
+ * @brief Writes all of an iovec array at a file offset, resuming after
+ *        partial writes.
+ * 
+ * @param fd (target file descriptor)
+ * @param iov (iovec array, modified while writing)
+ * @param iovcnt (number of entries in iov)
+ * @param offset (file offset to write at, advanced past the written data)
+ * @return int (returns -1 on failure, otherwise 0)
+ */
+static int writev_all(int fd, struct iovec *iov, int iovcnt, off_t *offset) {
+    while (iovcnt > 0) {
+        ssize_t nwritten = pwritev(fd, iov, iovcnt, *offset);
+        if (nwritten == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        *offset += nwritten;
+        // skip the fully written entries and move into the partially written one
+        while (iovcnt > 0 && (size_t)nwritten >= iov->iov_len) {
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds a region to a save snapshot. A region that continues the
+ *        previous one in memory is merged into it.
+ * 
+ * @param job (the save job)
+ * @param p (start of the region)
+ * @param len (length of the region)
+ */
+static void snapshot_add(struct saveJob *job, char *p, size_t len) {
+    if (len == 0)
+        return;
+
+    if (job->nregions > 0) {
+        struct iovec *last = &job->regions[job->nregions - 1];
+        if ((char *)last->iov_base + last->iov_len == p) {
+            last->iov_len += len;
+            return;
+        }
+    }
+    if (job->nregions == job->regcap) {
+        job->regcap = job->regcap ? job->regcap * 2 : 1024;
+        job->regions = realloc(job->regions, sizeof(struct iovec) * job->regcap);
+    }
+    job->regions[job->nregions].iov_base = p;
+    job->regions[job->nregions++].iov_len = len;
+}
+
+/**
+ * @brief Takes a snapshot of the rows from @from onwards for a background
+ *        save. The row storage itself is not copied - owned rows are marked
+ *        ROW_SHARED, so they are copied before their next edit instead (while
+ *        the save is running). Unedited rows of a mapped file are taken along
+ *        with their line ending from the mapping, so runs of them collapse
+ *        into a single region. In windowed mode a full save starts with the
+ *        unloaded lines before the window.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param job (the save job being filled)
+ * @param from (first row in the snapshot)
+ * @return off_t (number of bytes in the snapshot)
+ */
+static off_t snapshot_rows(eState *state, struct saveJob *job, int from) {
+    static char newline[] = "\r\n";
+    char *map_end = state->map ? state->map + state->mapsize : NULL;
+    off_t total = 0;
+
+    if (state->lines && !job->tail) {
+        total = state->lines->off[state->winfirst];
+        snapshot_add(job, state->map, total);
+    }
+
+    for (int j = from; j < state->numrows; j++) {
+        erow *row = editorRow(state, j);
+        size_t len = editorRowFileLen(state, row);
+        char *ending = (ROW_FLAGS(row) & ROW_CRLF) ? newline : &newline[1];
+        size_t body = len - ((ROW_FLAGS(row) & ROW_CRLF) ? 2 : 1); // all of a line cut short (ROW_CUT)
+        total += len;
+
+        if (ROW_FLAGS(row) & ROW_MAPPED) {
+            if (row->chars + len <= map_end && !memcmp(&row->chars[body], ending, len - body)) {
+                snapshot_add(job, row->chars, len);
+                continue;
+            }
+        } else {
+            editorRowFlatten(row);
+            ROW_FLAGS(row) |= ROW_SHARED;
+        }
+        snapshot_add(job, row->chars, body);
+        snapshot_add(job, ending, len - body);
+    }
+    return total;
+}
+
+/**
+ * @brief Adds the unloaded lines after the window to the snapshot, in
+ *        windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param job (the save job being filled)
+ * @return off_t (number of bytes added)
+ */
+static off_t snapshot_unloaded(eState *state, struct saveJob *job) {
+    if (state->lines == NULL || state->winlast == state->lines->count)
+        return 0;
+    size_t start = state->lines->off[state->winlast];
+    snapshot_add(job, &state->map[start], state->mapsize - start);
+    return state->mapsize - start;
+}
+
+/**
+ * @brief Writes the snapshot regions to a file at the snapshot offset, in
+ *        batches of EDDIE_SAVE_IOV_BATCH regions per pwritev call.
+ * 
+ * @param job (the save job)
+ * @param fd (target file descriptor)
+ * @return ssize_t (number of bytes written, -1 on failure)
+ */
+static ssize_t write_regions(struct saveJob *job, int fd) {
+    off_t offset = job->offset;
+    for (int j = 0; j < job->nregions; j += EDDIE_SAVE_IOV_BATCH) {
+        int iovcnt = job->nregions - j;
+        if (iovcnt > EDDIE_SAVE_IOV_BATCH)
+            iovcnt = EDDIE_SAVE_IOV_BATCH;
+        if (writev_all(fd, &job->regions[j], iovcnt, &offset) == -1)
+            return -1;
+    }
+    return offset - job->offset;
+}
+
+/**
+ * @brief Compresses the input set in a deflate stream (all of it) and
+ *        writes the compressed output to a file.
+ * 
+ * @param zs (the deflate stream)
+ * @param flush (Z_NO_FLUSH, or Z_FINISH to end the stream)
+ * @param fd (target file descriptor)
+ * @param offset (file offset to write at, advanced past the written data)
+ * @return int (returns -1 on failure, otherwise 0)
+ */
+static int deflate_to(z_stream *zs, int flush, int fd, off_t *offset) {
+    unsigned char out[1 << 16];
+    do { // deflate fills the whole output buffer only when it has more to write
+        zs->next_out = out;
+        zs->avail_out = sizeof(out);
+        deflate(zs, flush);
+        struct iovec iov = { out, sizeof(out) - zs->avail_out };
+        if (iov.iov_len > 0 && writev_all(fd, &iov, 1, offset) == -1)
+            return -1;
+    } while (zs->avail_out == 0);
+    return 0;
+}
+
+/**
+ * @brief Writes the snapshot regions to a file as a gzip stream.
+ * 
+ * @param job (the save job)
+ * @param fd (target file descriptor)
+ * @return ssize_t (number of compressed bytes written, -1 on failure)
+ */
+static ssize_t write_gzip(struct saveJob *job, int fd) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { // 15 + 16: gzip header
+        errno = ENOMEM;
+        return -1;
+    }
+
+    off_t offset = 0;
+    int err = 0;
+    for (int j = 0; j < job->nregions && !err; j++) {
+        char *p = job->regions[j].iov_base;
+        size_t left = job->regions[j].iov_len;
+        while (left > 0 && !err) { // avail_in is only 32 bits wide
+            uInt len = (left < (1u << 30)) ? left : (1u << 30);
+            zs.next_in = (Bytef *)p;
+            zs.avail_in = len;
+            err = deflate_to(&zs, Z_NO_FLUSH, fd, &offset);
+            p += len;
+            left -= len;
+        }
+    }
+    if (!err)
+        err = deflate_to(&zs, Z_FINISH, fd, &offset);
+    deflateEnd(&zs);
+    return err ? -1 : offset;
+}
+
+/**
+ * @brief Creates a path for a hidden temporary file next to @path
+ *        (in the same directory, so it can be renamed over it).
+ *        User is expected to free the returned path.
+ * 
+ * @param path (path of the file being replaced)
+ * @return char* (mkstemp template for the temporary file)
+ */
+static char *temp_path(const char *path) {
+    const char *base = strrchr(path, '/');
+    int dirlen = base ? base - path + 1 : 0;
+    base = base ? base + 1 : path;
+
+    size_t len = strlen(path) + sizeof("..XXXXXX");
+    char *tmp = malloc(len);
+    snprintf(tmp, len, "%.*s.%s.XXXXXX", dirlen, path, base);
+    return tmp;
+}
+
+/**
+ * @brief Flushes a directory entry change (like a rename) to disk.
+ *        Failure is ignored, the file itself was already synced.
+ * 
+ * @param path (path of the file inside the directory)
+ */
+static void sync_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash - path + 1) : strdup(".");
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+/**
+ * @brief Saves the rows atomically - they are written to a temporary file
+ *        in the same directory, which is synced and renamed over the
+ *        target. A crash mid-save leaves the original file untouched.
+ *        The original permissions are kept, and symlinks are written through.
+ *        A gzip compressed file is written compressed again.
+ * 
+ * @param job (the save job)
+ * @return ssize_t (number of bytes written, -1 on failure with errno set)
+ */
+static ssize_t save_atomic(struct saveJob *job) {
+    char *target = realpath(job->filename, NULL);
+    if (target == NULL)
+        target = strdup(job->filename); // new file
+    char *tmp = temp_path(target);
+
+    ssize_t len = -1;
+    int fd = mkstemp(tmp);
+    if (fd != -1) {
+        struct stat st;
+        mode_t mode;
+        if (stat(target, &st) == 0) {
+            mode = st.st_mode & 07777;
+        } else {
+            mode_t mask = umask(0);
+            umask(mask);
+            mode = 0644 & ~mask;
+        }
+
+        if (fchmod(fd, mode) == -1 || (len = job->gzip ? write_gzip(job, fd) : write_regions(job, fd)) == -1 || fsync(fd) == -1) {
+            len = -1;
+            int err = errno;
+            close(fd);
+            unlink(tmp);
+            errno = err;
+        } else if (close(fd) == -1 || rename(tmp, target) == -1) {
+            len = -1;
+            int err = errno;
+            unlink(tmp);
+            errno = err;
+        } else {
+            sync_dir(target);
+        }
+    }
+
+    free(tmp);
+    free(target);
+    return len;
+}
+
+/**
+ * @brief Saves only the modified tail of the file - the snapshot is written
+ *        in place from the first modified byte, and the file is truncated
+ *        to its new length.
+ * 
+ * @param job (the save job)
+ * @return ssize_t (number of bytes written, -1 on failure with errno set)
+ */
+static ssize_t save_tail(struct saveJob *job) {
+    int fd = open(job->filename, O_WRONLY);
+    if (fd == -1)
+        return -1;
+
+    ssize_t len = write_regions(job, fd);
+    if (len == -1 || ftruncate(fd, job->offset + len) == -1 || fsync(fd) == -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    if (close(fd) == -1)
+        return -1;
+    return len;
+}
+
+/**
+ * @brief Background save thread - writes the snapshot and reports back.
+ * 
+ * @param arg (the save job)
+ * @return void* (unused)
+ */
+static void *save_thread(void *arg) {
+    struct saveJob *job = arg;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ssize_t written = job->tail ? save_tail(job) : save_atomic(job);
+    int err = errno;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_mutex_lock(&job->lock);
+    job->written = written;
+    job->err = err;
+    job->secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/**
+ * @brief Reports a finished background save and releases it.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+static void finish_save(eState *state) {
+    struct saveJob *job = state->save;
+    pthread_join(job->thread, NULL);
+    state->save = NULL;
+
+    if (job->written == -1) {
+        state->modoff = -1; // the file on disk is unknown, rewrite all of it next time
+        editorSetStatusMessage(state, "Can't save! I/O error: %s", strerror(job->err));
+    } else {
+        char rate[16];
+        editorFormatSize(rate, sizeof(rate), job->secs > 0 ? job->written / job->secs : 0);
+        if (job->tail) {
+            editorSetStatusMessage(state, "%zd bytes written to disk from byte %lld (%s/s)", job->written,
+                                   (long long)job->offset, rate);
+        } else {
+            state->map_current = 0; // the mapped file was replaced
+            editorSetStatusMessage(state, "%zd bytes written to disk (%s/s)", job->written, rate);
+        }
+        if (state->dirty == job->dirty) { // no edits were made since the snapshot
+            state->dirty = 0;
+            editorWindowRebase(state); // the window can load rows from the saved file now
+        }
+        editorJournalRebase(state, job->journal); // the journaled edits up to the snapshot are on disk now
+        editorFollowSaved(state);
+        editorCacheDrop(state); // describes the file before it was saved
+    }
+
+    for (int j = 0; j < job->nkeep; j++)
+        editorArenaRelease(state, job->keep[j]);
+    free(job->keep);
+    free(job->regions);
+    free(job->filename);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+}
+
+/**
+ * @brief Copies lines [first, count) of an indexed buffer into new rows
+ *        at the end of the row array.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param buf (the indexed buffer)
+ * @param idx (line index of buf)
+ * @param first (first line copied)
+ */
+static void insert_lines(eState *state, char *buf, struct lineidx *idx, int first) {
+    for (int j = first; j < idx->count; j++) {
+        char *line = &buf[idx->off[j]];
+        size_t linelen = lineIndexLen(idx, j);
+        int crlf = (linelen > 0 && line[linelen - 1] == '\r');
+        if (crlf)
+            linelen--;
+        editorInsertRow(state, state->numrows, line, editorRowFit(state, linelen));
+        if (crlf)
+            ROW_FLAGS(editorRow(state, state->numrows - 1)) |= ROW_CRLF;
+    }
+}
+
+/**
+ * @brief Copies the complete lines of a buffer filled a chunk at a time into
+ *        new rows at the end of the row array. The start of a last line
+ *        whose newline didn't come yet stays in the buffer.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param partial (the buffer, left with the start of the last line)
+ * @param eof (whether no more chunks come - the last line is complete too)
+ */
+static void insert_complete(eState *state, struct abuf *partial, int eof) {
+    if (partial->len == 0)
+        return;
+    struct lineidx idx = LINEIDX_INIT;
+    lineIndexBuild(&idx, partial->b, partial->len);
+    size_t used = partial->len;
+    if (!eof && idx.off[idx.count] > used) {
+        idx.count--; // the last line goes on in the next chunk
+        used = idx.off[idx.count];
+    }
+    int dirty = state->dirty;
+    insert_lines(state, partial->b, &idx, 0);
+    state->dirty = dirty; // the rows were read, not typed
+    lineIndexFree(&idx);
+    memmove(partial->b, &partial->b[used], partial->len - used);
+    partial->len -= used;
+}
+
+/**
+ * @brief Marks the loaded rows as matching the file on disk.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param idx (line index of the file)
+ * @param size (size of the file)
+ */
+static void mark_loaded(eState *state, struct lineidx *idx, size_t size) {
+    // only a last line with no newline will be rewritten
+    state->disksize = size;
+    state->modrow = idx->count;
+    state->modoff = size;
+    if (idx->off[idx->count] > size) {
+        state->modrow--;
+        state->modoff = idx->off[idx->count - 1];
+    }
+}
+
+/**
+ * @brief Creates the editor rows from an indexed buffer, the rows point
+ *        into it lazily instead of copying it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param buf (the file contents, kept as state->map)
+ * @param idx (line index of buf)
+ * @param size (size of buf)
+ */
+static void load_rows(eState *state, char *buf, struct lineidx *idx, size_t size) {
+    if (idx->count == 0) {
+        state->modoff = 0;
+        return;
+    }
+
+    editorSetLineCount(state, idx->count); // the line count is known up-front, so the numbering column width is set only once.
+
+    editorLoadRows(state, state->numrows, buf, idx, 0, idx->count);
+    mark_loaded(state, idx, size);
+}
+
+/**
+ * @brief Indexes the next chunk of a file loading in the background, and
+ *        queues its lines to be handed over. The chunk is cut after its
+ *        last newline, so the lines are complete.
+ * 
+ * @param loader (the background load)
+ * @param from (offset of the chunk)
+ * @param len (length of the chunk, before it is cut)
+ * @return size_t (offset of the end of the chunk)
+ */
+static size_t scan_chunk(struct fileLoader *loader, size_t from, size_t len) {
+    char *map = loader->map;
+    size_t to = (len < loader->size - from) ? from + len : loader->size;
+    if (to < loader->size) {
+        char *nl = memrchr(&map[from], '\n', to - from);
+        if (nl == NULL) // a single line longer than the chunk
+            nl = memchr(&map[to], '\n', loader->size - to);
+        to = nl ? (size_t)(nl - map) + 1 : loader->size;
+    }
+
+    struct lineidx chunk = LINEIDX_INIT;
+    lineIndexBuild(&chunk, &map[from], to - from);
+    pthread_mutex_lock(&loader->lock);
+    lineIndexAppend(&loader->pending, &chunk, from);
+    loader->scanned = to;
+    pthread_mutex_unlock(&loader->lock);
+    editorCacheWriteLines(loader->cache, &chunk, from);
+    lineIndexFree(&chunk);
+    return to;
+}
+
+/**
+ * @brief Background loader thread - indexes the rest of the file in chunks
+ *        that double in size, so the later ones are big enough to be
+ *        indexed by all the index threads at once.
+ * 
+ * @param arg (the background load)
+ * @return void* (unused)
+ */
+static void *load_thread(void *arg) {
+    struct fileLoader *loader = arg;
+    size_t max = (size_t)EDDIE_INDEX_SLICE * EDDIE_INDEX_THREADS;
+    size_t len = EDDIE_LOAD_FIRST;
+    size_t from = loader->scanned;
+
+    if (loader->window)
+        madvise(loader->map, loader->size, MADV_SEQUENTIAL); // read ahead, and let the pages behind the scan go first
+    while (from < loader->size) {
+        len = (len < max / 2) ? len * 2 : max;
+        from = scan_chunk(loader, from, len);
+    }
+    if (loader->window) {
+        madvise(loader->map, loader->size, MADV_NORMAL);
+        madvise(loader->map, loader->size, MADV_DONTNEED); // unmap the scanned pages, only the window is read again
+    }
+    editorCacheWriteEnd(loader->cache, loader->fd);
+
+    pthread_mutex_lock(&loader->lock);
+    loader->done = 1;
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+/**
+ * @brief Hands the lines indexed by the background loader over to the
+ *        editor - they are loaded as rows, or added to the window index
+ *        (the window loads them once the cursor gets there). The caller
+ *        holds the loader lock, or the loader thread finished.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether any lines were handed over)
+ */
+static int hand_over(eState *state) {
+    struct fileLoader *loader = state->load;
+    struct lineidx *lines = loader->lines;
+    if (loader->pending.count == 0)
+        return 0;
+
+    long long first = lines->count;
+    lineIndexAppend(lines, &loader->pending, 0);
+    loader->pending.off[0] = loader->pending.off[loader->pending.count];
+    loader->pending.count = 0; // the next lines start where these end
+    loader->loaded = loader->scanned;
+    if (!loader->window)
+        editorLoadRows(state, state->numrows, loader->map, lines, first, lines->count - first);
+
+    editorSetLineCount(state, lines->count);
+    return 1;
+}
+
+/**
+ * @brief Hands over the last lines of a background load, and releases it.
+ *        The cache entry the loader thread wrote becomes the entry of the
+ *        file, if the file didn't change while it loaded.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param join (whether the loader thread has to be joined - not if it never started)
+ */
+static void finish_load(eState *state, int join) {
+    struct fileLoader *loader = state->load;
+    if (join)
+        pthread_join(loader->thread, NULL);
+    hand_over(state);
+    state->load = NULL;
+
+    if (!loader->window)
+        mark_loaded(state, loader->lines, loader->size);
+    editorCacheWriteAdopt(state, loader->cache);
+
+    if (loader->fd != -1)
+        close(loader->fd);
+    lineIndexFree(&loader->own);
+    lineIndexFree(&loader->pending);
+    pthread_mutex_destroy(&loader->lock);
+    free(loader);
+}
+
+/**
+ * @brief Maps the open file into memory and loads its rows lazily - the rows
+ *        point into the mapping until they are edited, and are only rendered
+ *        once they are displayed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param size (size of the file in bytes)
+ * @return int (returns -1 if the file could not be mapped, otherwise 0)
+ */
+static int open_mapped(eState *state, int fd, size_t size) {
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    state->map = map;
+    state->mapsize = size;
+    state->map_current = 1;
+
+    struct lineidx idx = LINEIDX_INIT;
+    if (editorCacheLoad(state, fd, &idx) == -1) {
+        lineIndexFree(&idx);
+        editorLoadStart(state, fd);
+        return 0;
     }
+    load_rows(state, map, &idx, size);
+    lineIndexFree(&idx);
+    return 0;
+}
 
-    rewind(fp);
-    
-    return line_count;
+/**
+ * @brief Reads the whole open file into an anonymous mapping and loads its
+ *        rows from it, like from a file mapping - the unedited text is not
+ *        copied again. The mapping grows while the file is read, and is
+ *        shrunk to the size of the file after.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @return int (returns -1 on read error, otherwise 0)
+ */
+static int open_read(eState *state, int fd) {
+    size_t cap = 4096;
+    size_t size = 0;
+    char *buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+        return -1;
+    ssize_t nread;
+    while ((nread = read(fd, &buf[size], cap - size)) != 0) {
+        if (nread == -1) {
+            if (errno == EINTR)
+                continue;
+            munmap(buf, cap);
+            return -1;
+        }
+        size += nread;
+        if (size == cap) {
+            char *grown = mremap(buf, cap, cap * 2, MREMAP_MAYMOVE);
+            if (grown == MAP_FAILED) {
+                munmap(buf, cap);
+                return -1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+
+    if (size == 0) { // nothing to point into
+        munmap(buf, cap);
+        state->modoff = 0;
+        return 0;
+    }
+    state->map = mremap(buf, cap, size, 0); // shrinks in place, the pages past the file are not needed
+    state->mapsize = size;
+    state->map_current = 0; // a copy, the file on disk can be rewritten under it
+
+    struct lineidx idx = LINEIDX_INIT;
+    lineIndexBuild(&idx, state->map, size);
+    load_rows(state, state->map, &idx, size);
+    lineIndexFree(&idx);
+    return 0;
 }
 
 /**
- * @brief Convert an erow array into a single string ready for 
- *        writing to a file.
+ * @brief Checks the open file for the gzip magic bytes.
  * 
- * @param buflen (pointer to int the function will store the resulting length into)
- * @param numrows (number of rows being converted)
- * @param rows (pointer to the editor row array)
- * @return char* (the converted string)
+ * @param fd (descriptor of the open file)
+ * @return int (whether the file is gzip compressed)
  */
-static char *rows_to_string(int *buflen, int numrows, erow *rows) {
-    int totlen = 0;
-    int j;
+static int is_gzip(int fd) {
+    unsigned char magic[2];
+    return pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && magic[0] == 0x1f && magic[1] == 0x8b;
+}
 
-    for (j = 0; j < numrows; j++)
-        totlen += rows[j].size + 1; // extra char for newline
-    *buflen = totlen;
+/**
+ * @brief Decompresses the open gzip file while reading it, straight into
+ *        rows - only a chunk of it is held decompressed at a time.
+ *        Concatenated gzip members are read one after the other. A file
+ *        cut short (still being written) or corrupt is read as far as it goes.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @return int (returns -1 on read error, otherwise 0)
+ */
+static int open_gzip(eState *state, int fd) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) { // 15 + 16: gzip header
+        errno = ENOMEM;
+        return -1;
+    }
 
-    char *buf = malloc(totlen);
-    char *loc = buf;
-    for (j = 0; j < numrows; j++) {
-        memcpy(loc, rows[j].chars, rows[j].size);
-        loc += rows[j].size;
-        *loc = '\n';
-        loc++;
+    unsigned char in[1 << 16];
+    unsigned char out[1 << 16];
+    struct abuf partial = ABUF_INIT;
+    int ret = Z_OK;
+    int err = 0;
+    ssize_t nread;
+    while (!err && ret != Z_DATA_ERROR && (nread = read(fd, in, sizeof(in))) != 0) {
+        if (nread == -1) {
+            err = (errno != EINTR);
+            continue;
+        }
+        zs.next_in = in;
+        zs.avail_in = nread;
+        do { // inflate fills the whole output buffer only when it has more to give
+            if (ret == Z_STREAM_END)
+                inflateReset(&zs); // the next member
+            zs.next_out = out;
+            zs.avail_out = sizeof(out);
+            ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret == Z_DATA_ERROR || ret == Z_MEM_ERROR || ret == Z_NEED_DICT) {
+                ret = Z_DATA_ERROR;
+                break;
+            }
+            abAppend(&partial, (char *)out, sizeof(out) - zs.avail_out);
+            insert_complete(state, &partial, 0);
+        } while (zs.avail_in > 0 || zs.avail_out == 0);
     }
+    inflateEnd(&zs);
+    if (!err) {
+        insert_complete(state, &partial, 1);
+        if (ret == Z_DATA_ERROR)
+            editorSetStatusMessage(state, "%.20s is corrupt - only the start was read", state->filename);
+        else if (ret != Z_STREAM_END)
+            editorSetStatusMessage(state, "%.20s is cut short - saving it drops the lost end", state->filename);
+    }
+    abFree(&partial);
+    state->modoff = -1; // a compressed file is always rewritten whole
+    return err ? -1 : 0;
+}
 
-    return buf;
+/**
+ * @brief Loads the rows of an open file - windowed, mapped or read
+ *        depending on its size, or decompressed if it is gzip compressed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @return int (returns -1 on read error, otherwise 0)
+ */
+static int open_file(eState *state, int fd) {
+    struct stat st;
+    int mapped = 0;
+    state->gzip = is_gzip(fd);
+    if (!state->gzip && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size >= EDDIE_WINDOW_THRESHOLD)
+            mapped = (editorWindowOpen(state, fd, st.st_size) == 0);
+        else if (st.st_size >= EDDIE_MMAP_THRESHOLD)
+            mapped = (open_mapped(state, fd, st.st_size) == 0);
+    }
+    if (!mapped && (state->gzip ? open_gzip(state, fd) : open_read(state, fd)) == -1)
+        return -1;
+    state->dirty = 0;
+    return 0;
 }
 
 void editorOpen(eState *state, char *filename) {
@@ -63,33 +871,236 @@ void editorOpen(eState *state, char *filename) {
 
     editorSelectSyntaxHighlight(state);
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp)
-        die("fopen");
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        die("open");
+    if (open_file(state, fd) == -1)
+        die("read");
+    close(fd); // a mapping stays valid after the file is closed
+}
 
-    // pre-calculate line count to find the minimum width for numbering column.
-    int line_count = count_lines(fp);
+int editorReload(eState *state) {
+    int fd = open(state->filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
 
-    int linenum_w = floor(log10(abs(line_count))) + 2;
-    if (state->linenum_w != linenum_w) {
-        state->linenum_w = linenum_w;
-        state->editcols = state->screencols - state->linenum_w;
+    editorCacheDrop(state);
+    editorDropRows(state, 0, state->numrows);
+    if (state->lines != NULL) {
+        lineIndexFree(state->lines);
+        free(state->lines);
+        state->lines = NULL;
+    }
+    if (state->map != NULL) {
+        munmap(state->map, state->mapsize);
+        state->map = NULL;
+        state->mapsize = 0;
     }
+    state->map_current = 0;
+    state->winfirst = 0;
+    state->winlast = 0;
+    state->winhead = 0;
+    state->wintail = 0;
+    state->modrow = 0;
+    state->modoff = -1;
+    state->disksize = 0;
+    state->cut = 0;
 
-    char *line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
-    while ((linelen = getline(&line, &linecap, fp)) != -1) {
-        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-            linelen--;
-        editorInsertRow(state, state->numrows, line, linelen);
+    int err = open_file(state, fd);
+    close(fd);
+    return err;
+}
+
+int editorReadAppended(eState *state, int fd, off_t size) {
+    off_t from = state->disksize;
+    char last = '\n';
+    if (from > 0 && pread(fd, &last, 1, from - 1) != 1)
+        return -1;
+
+    // an unchanged last line with no newline is read again along with its continuation
+    int partial = (last != '\n' && state->numrows > 0);
+    int clean = (state->modoff != -1 && state->modrow == state->numrows - partial);
+    if (partial && clean) {
+        editorDropRows(state, state->numrows - 1, 1);
+        from = state->modoff;
+        partial = 0;
     }
-    free(line);
-    fclose(fp);
-    state->dirty = 0;
+
+    size_t len = size - from;
+    char *buf = malloc(len);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t nread = pread(fd, &buf[done], len - done, from + done);
+        if (nread == -1 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            break;
+        done += nread;
+    }
+    if (done < len) {
+        free(buf);
+        return -1;
+    }
+
+    struct lineidx idx = LINEIDX_INIT;
+    lineIndexBuild(&idx, buf, len);
+    int dirty = state->dirty;
+    struct journal *journal = state->journal;
+    state->journal = NULL; // the appended rows are not edits to journal either
+    int first = 0;
+    editorEditBegin(state);
+    if (partial && idx.count > 0) { // the continuation of an edited last line
+        size_t linelen = lineIndexLen(&idx, 0);
+        int crlf = (linelen > 0 && buf[linelen - 1] == '\r');
+        editorRowAppendString(state, editorRow(state, state->numrows - 1), buf, linelen - crlf);
+        if (crlf)
+            ROW_FLAGS(editorRow(state, state->numrows - 1)) |= ROW_CRLF;
+        first = 1;
+    }
+    insert_lines(state, buf, &idx, first);
+    editorEditCommit(state);
+    state->dirty = dirty; // the appended rows are the file on disk, not edits
+    state->journal = journal;
+
+    if (clean) { // the rows still match the file on disk
+        state->modrow = state->numrows;
+        state->modoff = size;
+        if (idx.count > 0 && idx.off[idx.count] > len) {
+            state->modrow--;
+            state->modoff = from + idx.off[idx.count - 1];
+        }
+    }
+    state->disksize = size;
+    lineIndexFree(&idx);
+    free(buf);
+    return 0;
+}
+
+void editorOpenPipe(eState *state, int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct pipeInput *input = malloc(sizeof(struct pipeInput));
+    input->fd = fd;
+    input->partial = (struct abuf)ABUF_INIT;
+    state->input = input;
+}
+
+int editorPipePoll(eState *state) {
+    struct pipeInput *input = state->input;
+    if (input == NULL)
+        return 0;
+
+    char chunk[1 << 16];
+    size_t total = 0;
+    int eof = 0;
+    while (total < EDDIE_PIPE_BATCH) {
+        ssize_t nread = read(input->fd, chunk, sizeof(chunk));
+        if (nread == -1 && errno == EINTR)
+            continue;
+        if (nread == -1 && errno == EAGAIN)
+            break; // nothing more for now
+        if (nread <= 0) {
+            eof = 1;
+            break;
+        }
+        abAppend(&input->partial, chunk, nread);
+        total += nread;
+    }
+    if (total == 0 && !eof)
+        return 0;
+
+    insert_complete(state, &input->partial, eof);
+    if (eof) {
+        close(input->fd);
+        abFree(&input->partial);
+        free(input);
+        state->input = NULL;
+        editorSetStatusMessage(state, "Read %d lines from standard input", state->numrows);
+    }
+    return 1;
+}
+
+void editorLoadStart(eState *state, int fd) {
+    struct fileLoader *loader = calloc(1, sizeof(struct fileLoader));
+    loader->pending = (struct lineidx)LINEIDX_INIT;
+    loader->map = state->map;
+    loader->size = state->mapsize;
+    loader->window = (state->lines != NULL);
+    loader->own = (struct lineidx)LINEIDX_INIT;
+    loader->lines = loader->window ? state->lines : &loader->own;
+    loader->fd = dup(fd);
+    if (loader->fd != -1)
+        loader->cache = editorCacheWriteStart(state, loader->fd);
+    pthread_mutex_init(&loader->lock, NULL);
+    state->load = loader;
+
+    loader->scanned = scan_chunk(loader, 0, EDDIE_LOAD_FIRST); // enough for the first screen
+    hand_over(state);
+    if (pthread_create(&loader->thread, NULL, load_thread, loader) != 0) {
+        load_thread(loader); // load the rest right away then
+        finish_load(state, 0);
+    }
+}
+
+int editorLoadPoll(eState *state) {
+    struct fileLoader *loader = state->load;
+    if (loader == NULL)
+        return 0;
+
+    pthread_mutex_lock(&loader->lock);
+    int done = loader->done;
+    int loaded = hand_over(state);
+    pthread_mutex_unlock(&loader->lock);
+    if (done)
+        finish_load(state, 1);
+    return loaded || done;
+}
+
+void editorLoadWait(eState *state) {
+    if (state->load)
+        finish_load(state, 1);
+}
+
+int editorLoadProgress(eState *state) {
+    if (state->load == NULL)
+        return -1;
+    return state->load->loaded * 100 / state->load->size;
+}
+
+/**
+ * @brief Checks whether the next save can rewrite only the modified tail of
+ *        the file: the first modified byte is known (and is not near the
+ *        start), the file is large enough for it to matter, and the file on
+ *        disk was not changed by someone else. The unloaded lines after a
+ *        window can't be rewritten in place from a mapping of the same file,
+ *        nor can the rest of a line cut short (ROW_CUT), and a compressed
+ *        file can't be rewritten in part.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether the tail can be saved in place)
+ */
+static int can_save_tail(eState *state) {
+    struct stat st;
+    if (state->gzip || (state->lines && state->map_current && state->winlast < state->lines->count))
+        return 0;
+    for (int j = state->modrow; state->map_current && state->lines && j < state->numrows; j++) {
+        if (ROW_FLAGS(editorRow(state, j)) & ROW_CUT)
+            return 0; // the rest of the line can't be copied out of the bytes being overwritten
+    }
+    return state->modoff != -1 && state->disksize >= EDDIE_TAIL_SAVE_THRESHOLD &&
+           stat(state->filename, &st) == 0 && st.st_size == state->disksize;
 }
 
 void editorSave(eState *state) {
+    editorLoadWait(state); // the snapshot is of the whole file
+    if (state->save) {
+        editorSetStatusMessage(state, "A save is already in progress");
+        return;
+    }
+    if (state->cut) {
+        editorSetStatusMessage(state, "Can't save! A line longer than %d bytes was cut short", EDDIE_MAX_ROW);
+        return;
+    }
+
     if (state->filename == NULL) { // no file was open, prompt the user to save as
         state->filename = editorPrompt(state, "Save as: %s", NULL);
         if (state->filename == NULL) {
@@ -99,23 +1110,75 @@ void editorSave(eState *state) {
         editorSelectSyntaxHighlight(state);
     }
 
-    int len;
-    char *buf = rows_to_string(&len, state->numrows, state->row);
-
-    int fd = open(state->filename, O_RDWR | O_CREAT, 0644);
-    if (fd != -1) {
-        if (ftruncate(fd, len) != -1) {
-            if (write(fd, buf, len) == len) {
-                close(fd);
-                free(buf);
-                state->dirty = 0;
-                editorSetStatusMessage(state, "%d bytes written to disk", len);
-                return;
-            }
+    struct saveJob *job = calloc(1, sizeof(struct saveJob));
+    job->filename = strdup(state->filename);
+    job->dirty = state->dirty;
+    job->journal = editorJournalMark(state);
+    job->gzip = state->gzip;
+    job->tail = can_save_tail(state);
+    if (job->tail) {
+        job->offset = state->modoff;
+        if (state->map_current) {
+            // the mapped rows in the tail read from the very bytes being overwritten
+            for (int j = state->modrow; j < state->numrows; j++)
+                editorRowOwnChars(state, editorRow(state, j));
         }
-        close(fd);
     }
+    off_t len = snapshot_rows(state, job, job->tail ? state->modrow : 0);
+    off_t rest = snapshot_unloaded(state, job);
 
-    free(buf);
-    editorSetStatusMessage(state, "Can't save! I/O error: %s", strerror(errno));
+    // the file on disk is expected to match the snapshot from now on
+    state->modrow = state->numrows;
+    state->modoff = job->offset + len;
+    state->disksize = job->offset + len + rest;
+
+    pthread_mutex_init(&job->lock, NULL);
+    int err = pthread_create(&job->thread, NULL, save_thread, job);
+    if (err != 0) {
+        state->modoff = -1;
+        editorSetStatusMessage(state, "Can't save! %s", strerror(err));
+        pthread_mutex_destroy(&job->lock);
+        free(job->regions);
+        free(job->filename);
+        free(job);
+        return;
+    }
+    state->save = job;
+    editorSetStatusMessage(state, "Saving...");
+}
+
+int editorSavePoll(eState *state) {
+    if (state->save == NULL)
+        return 0;
+
+    pthread_mutex_lock(&state->save->lock);
+    int done = state->save->done;
+    pthread_mutex_unlock(&state->save->lock);
+    if (done)
+        finish_save(state);
+    return done;
+}
+
+void editorSaveWait(eState *state) {
+    if (state->save)
+        finish_save(state);
+}
+
+void editorSaveKeep(eState *state, char *chars) {
+    struct saveJob *job = state->save;
+    if (job->nkeep == job->keepcap) {
+        job->keepcap = job->keepcap ? job->keepcap * 2 : 64;
+        job->keep = realloc(job->keep, sizeof(char *) * job->keepcap);
+    }
+    job->keep[job->nkeep++] = chars;
+}
+
+void editorFormatSize(char *buf, size_t buflen, double bytes) {
+    static const char *units[] = { "B", "KB", "MB", "GB", "TB" };
+    unsigned int unit = 0;
+    while (bytes >= 1024 && unit < sizeof(units) / sizeof(units[0]) - 1) {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(buf, buflen, "%.1f %s", bytes, units[unit]);
 }
@@ -0,0 +1,220 @@
+#include "syshead.h"
+
+#include "follow.h"
+#include "buffer.h"
+#include "cache.h"
+#include "file.h"
+#include "journal.h"
+#include "lineidx.h"
+#include "structs.h"
+#include "terminal.h"
+#include "window.h"
+
+/**
+ * @brief The inotify watches of follow mode. The file itself is watched for
+ *        writes, and its directory for a new file taking its name (when a
+ *        log is rotated, or a file is saved by rename).
+ * 
+ * {
+ *      int fd; (the inotify instance)
+ *      int file; (watch of the followed file, -1 once it's gone)
+ *      int dir; (watch of the directory of the file)
+ *      char *name; (name of the file in its directory)
+ *      dev_t dev; (device of the followed file)
+ *      ino_t ino; (inode of the followed file - a different one means the file was replaced)
+ * }
+ */
+struct followWatch {
+    int fd;
+    int file;
+    int dir;
+    char *name;
+    dev_t dev;
+    ino_t ino;
+};
+
+/**
+ * @brief Watches the file under the open file name (which may be a new one),
+ *        and remembers which file it is.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+static void watch_file(eState *state) {
+    struct followWatch *follow = state->follow;
+    if (follow->file != -1)
+        inotify_rm_watch(follow->fd, follow->file);
+    follow->file = inotify_add_watch(follow->fd, state->filename, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+
+    struct stat st;
+    if (stat(state->filename, &st) == 0) {
+        follow->dev = st.st_dev;
+        follow->ino = st.st_ino;
+    }
+}
+
+/**
+ * @brief Reads all pending inotify events.
+ * 
+ * @param follow (the watches)
+ * @return int (whether any event was about the followed file)
+ */
+static int drain_events(struct followWatch *follow) {
+    char buf[4096];
+    int changed = 0;
+    ssize_t nread;
+    while ((nread = read(follow->fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < nread;) {
+            struct inotify_event event;
+            memcpy(&event, &buf[off], sizeof(event)); // the buffer is not aligned for the struct
+            const char *name = &buf[off + sizeof(event)];
+            if (event.wd == follow->file) {
+                changed = 1;
+                if (event.mask & IN_IGNORED)
+                    follow->file = -1; // the file was deleted, its watch went with it
+            } else if (event.wd == follow->dir && event.len > 0 && strcmp(name, follow->name) == 0) {
+                changed = 1;
+            }
+            off += sizeof(event) + event.len;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Puts the cursor at the start of line @line of the file (or the
+ *        last line, if the file is shorter) - moving the window there first
+ *        in windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param line (the line moved to)
+ */
+static void goto_line(eState *state, long long line) {
+    if (state->lines != NULL && (line < state->winfirst || line >= state->winlast))
+        editorWindowGoto(state, line < state->lines->count ? line : state->lines->count - 1);
+    long long cy = line - state->winfirst;
+    if (cy > state->numrows - 1)
+        cy = state->numrows - 1;
+    state->cy = (cy > 0) ? cy : 0;
+    state->cx = 0;
+    state->wrapoff = 0;
+    state->ix = 0;
+    state->iy = 0;
+}
+
+/**
+ * @brief Indexes the file again after it was truncated or replaced, keeping
+ *        the cursor on the same line (or the last line, if it was there).
+ *        A file with unsaved edits is left alone.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at_end (whether the cursor was on the last line)
+ * @return int (whether the file was reloaded)
+ */
+static int reload(eState *state, int at_end) {
+    if (state->dirty) {
+        editorSetStatusMessage(state, "%.20s changed on disk - not reloaded over unsaved changes", state->filename);
+        return 1;
+    }
+    long long line = state->winfirst + state->cy;
+    if (editorReload(state) == -1)
+        return 0; // being replaced, the directory watch catches the new file
+    watch_file(state); // the file may be a new one
+    editorJournalRebase(state, editorJournalMark(state));
+    goto_line(state, at_end ? editorTotalRows(state) - 1 : line);
+    state->rowoff = at_end ? 0 : state->cy; // the rows above may be gone - scroll to the cursor again
+    return 1;
+}
+
+/**
+ * @brief Compares the file on disk with what was last read or written of it:
+ *        loads what was appended, or indexes it again if it was truncated
+ *        or replaced.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether the file changed - the screen should be redrawn)
+ */
+static int sync_file(eState *state) {
+    struct followWatch *follow = state->follow;
+    int fd = open(state->filename, O_RDONLY);
+    if (fd == -1)
+        return 0; // gone for now, the directory watch catches it coming back
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return 0;
+    }
+
+    int at_end = (state->cy >= state->numrows - 1 &&
+                  (state->lines == NULL || state->winlast == state->lines->count));
+    int replaced = (st.st_dev != follow->dev || st.st_ino != follow->ino);
+    int redraw = 0;
+    if (replaced || st.st_size < state->disksize || (state->lines != NULL && !state->map_current)) {
+        redraw = reload(state, at_end);
+    } else if (st.st_size > state->disksize) {
+        editorCacheDrop(state); // the cached index ends at the old size
+        int err = (state->lines != NULL) ? editorWindowExtend(state, fd, st.st_size)
+                                         : editorReadAppended(state, fd, st.st_size);
+        if (err == 0)
+            editorJournalRebase(state, 0); // the journaled edits apply to the grown file just the same
+        if (err == 0 && at_end)
+            goto_line(state, editorTotalRows(state) - 1);
+        redraw = 1;
+    }
+    close(fd);
+    return redraw;
+}
+
+void editorFollowToggle(eState *state) {
+    struct followWatch *follow = state->follow;
+    if (follow != NULL) {
+        close(follow->fd); // closing the instance removes its watches
+        free(follow->name);
+        free(follow);
+        state->follow = NULL;
+        editorSetStatusMessage(state, "Follow mode off");
+        return;
+    }
+    if (state->filename == NULL) {
+        editorSetStatusMessage(state, "No file to follow");
+        return;
+    }
+    if (state->gzip) {
+        editorSetStatusMessage(state, "Can't follow a compressed file");
+        return;
+    }
+    editorLoadWait(state); // appends are detected against the size of the whole file
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) {
+        editorSetStatusMessage(state, "Can't follow! inotify error: %s", strerror(errno));
+        return;
+    }
+    follow = malloc(sizeof(struct followWatch));
+    follow->fd = fd;
+    follow->file = -1;
+    char *slash = strrchr(state->filename, '/');
+    follow->name = strdup(slash ? slash + 1 : state->filename);
+    char *dir = slash ? strndup(state->filename, slash - state->filename + 1) : strdup(".");
+    follow->dir = inotify_add_watch(fd, dir, IN_CREATE | IN_MOVED_TO);
+    free(dir);
+    state->follow = follow;
+    watch_file(state);
+
+    editorSetStatusMessage(state, "Following %.20s - Ctrl-T to stop", state->filename);
+    sync_file(state); // catch up with what was appended since the file was read
+}
+
+int editorFollowPoll(eState *state) {
+    if (state->follow == NULL || state->save != NULL)
+        return 0; // a save in progress is reported with editorFollowSaved
+    if (!drain_events(state->follow))
+        return 0;
+    return sync_file(state);
+}
+
+void editorFollowSaved(eState *state) {
+    if (state->follow == NULL)
+        return;
+    drain_events(state->follow);
+    watch_file(state);
+}
@@ -1,8 +1,10 @@
 #include "syshead.h"
 
 #include "highlight.h"
+#include "buffer.h"
 #include "consts.h"
 #include "filetype.h"
+#include "rowidx.h"
 #include "structs.h"
 
 /**
@@ -18,16 +20,39 @@ static int is_separator(int c) {
 
 void editorUpdateSyntaxBackground(erow *row) {
     // for now, only set background as normal.
-    row->bg = realloc(row->bg, row->rsize);
-    memset(row->bg, BG_NORMAL, row->rsize);
+    memset(row->rd->bg, BG_NORMAL, row->rd->rsize);
 }
 
-void editorUpdateSyntaxForeground(eState *state, erow *row) {
-    row->hl = realloc(row->hl, row->rsize);
-    memset(row->hl, HL_NORMAL, row->rsize); // reset everything to normal
+/**
+ * @brief Checks whether string s of length len is at index i of a rendered
+ *        line, without reading past its end.
+ * 
+ * @param render (the rendered line)
+ * @param rsize (length of the rendered line)
+ * @param i (index in the line)
+ * @param s (the string)
+ * @param len (length of the string)
+ * @return int (boolean value - true if the line has s at i)
+ */
+static int match_at(char *render, int rsize, int i, char *s, int len) {
+    return len <= rsize - i && !memcmp(&render[i], s, len);
+}
+
+/**
+ * @brief Sets the foreground highlight values of a rendered line.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param render (the rendered line, which need not be null-terminated)
+ * @param rsize (length of the rendered line)
+ * @param hl (highlight array of rsize codes to fill)
+ * @param in_comment (whether a multiline comment is open at the start of the line)
+ * @return int (whether a multiline comment is open at the end of the line)
+ */
+static int highlight_line(eState *state, char *render, int rsize, unsigned char *hl, int in_comment) {
+    memset(hl, HL_NORMAL, rsize); // reset everything to normal
 
     if (state->syntax == NULL)
-        return;
+        return 0;
 
     char **keywords = state->syntax->keywords;
 
@@ -43,25 +68,24 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
     int in_string = 0;
     int lt_start = 0; // start location is saved to allow for non-closed lt (like in comparisons)
     int in_hashtag = 0;
-    int in_comment = (row->idx > 0 && state->row[row->idx - 1].hl_open_comment);
 
     int i = 0;
-    while (i < row->rsize) {
-        char c = row->render[i];
-        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+    while (i < rsize) {
+        char c = render[i];
+        unsigned char prev_hl = (i > 0) ? hl[i - 1] : HL_NORMAL;
 
         if (scs_len && !in_string && !in_comment) {
-            if (!strncmp(&row->render[i], scs, scs_len)) {
-                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+            if (match_at(render, rsize, i, scs, scs_len)) {
+                memset(&hl[i], HL_COMMENT, rsize - i);
                 break; // single-line comment spans across the entire row - no need for further calculations
             }
         }
 
         if (mcs_len && mce_len && !in_string) {
             if (in_comment) {
-                row->hl[i] = HL_MLCOMMENT;
-                if (!strncmp(&row->render[i], mce, mce_len)) {
-                    memset(&row->hl[i], HL_MLCOMMENT, mce_len); // set the end of comment characters to comment before continuing
+                hl[i] = HL_MLCOMMENT;
+                if (match_at(render, rsize, i, mce, mce_len)) {
+                    memset(&hl[i], HL_MLCOMMENT, mce_len); // set the end of comment characters to comment before continuing
                     i += mce_len;
                     in_comment = 0;
                     prev_sep = 1;
@@ -70,8 +94,8 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
                     i++;
                     continue;
                 }
-            } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+            } else if (match_at(render, rsize, i, mcs, mcs_len)) {
+                memset(&hl[i], HL_MLCOMMENT, mcs_len);
                 i += mcs_len;
                 in_comment = 1;
                 continue;
@@ -80,7 +104,7 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
 
         if (state->syntax->flags & HL_HIGHLIGHT_LTGT) {
             if (lt_start && c == '>') { // only set ltgt after finding the closing gt
-                memset(&row->hl[lt_start - 1], HL_LTGT, i - lt_start + 2);
+                memset(&hl[lt_start - 1], HL_LTGT, i - lt_start + 2);
                 lt_start = 0;
                 prev_sep = 1;
                 i++;
@@ -92,9 +116,9 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
 
         if (state->syntax->flags & HL_HIGHLIGHT_STRINGS) {
             if (in_string) {
-                row->hl[i] = HL_STRING;
-                if (c == '\\' && i + 1 < row->rsize) {
-                    row->hl[i + 1] = HL_STRING;
+                hl[i] = HL_STRING;
+                if (c == '\\' && i + 1 < rsize) {
+                    hl[i + 1] = HL_STRING;
                     i += 2;
                     continue;
                 }
@@ -106,7 +130,7 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
             } else {
                 if (c == '"' || c == '\'') {
                     in_string = c;
-                    row->hl[i] = HL_STRING;
+                    hl[i] = HL_STRING;
                     i++;
                     continue;
                 }
@@ -115,12 +139,12 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
 
         if (state->syntax->flags & HL_HIGHLIGHT_HASHTAG) {
             if (in_hashtag) {
-                row->hl[i] = HL_HASHTAG;
+                hl[i] = HL_HASHTAG;
                 i++;
                 continue;
-            } else if (!strncmp(&row->render[i], HASHTAG, 1)) {
+            } else if (match_at(render, rsize, i, HASHTAG, 1)) {
                 in_hashtag = 1;
-                row->hl[i] = HL_HASHTAG;
+                hl[i] = HL_HASHTAG;
                 i++;
                 continue;
             }
@@ -128,7 +152,7 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
 
         if (state->syntax->flags & HL_HIGHLIGHT_NUMBERS) {
             if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER)) {
-                row->hl[i] = HL_NUMBER;
+                hl[i] = HL_NUMBER;
                 i++;
                 prev_sep = 0;
                 continue;
@@ -144,9 +168,9 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
                 if (kw2 || kw3)
                     klen--; // "remove" mark from end of keyword for comparing
 
-                if (!strncmp(&row->render[i], keywords[j], klen) &&
-                    is_separator(row->render[i + klen])) {
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : (kw3 ? HL_KEYWORD3 : HL_KEYWORD1), klen);
+                if (match_at(render, rsize, i, keywords[j], klen) &&
+                    (i + klen == rsize || is_separator(render[i + klen]))) {
+                    memset(&hl[i], kw2 ? HL_KEYWORD2 : (kw3 ? HL_KEYWORD3 : HL_KEYWORD1), klen);
                     i += klen;
                     break;
                 }
@@ -161,13 +185,98 @@ void editorUpdateSyntaxForeground(eState *state, erow *row) {
         i++;
     }
 
-    int changed = (row->hl_open_comment != in_comment); // marks change that affects next row
-    row->hl_open_comment = in_comment;
-    if (changed && row->idx + 1 < state->numrows)
-        editorUpdateSyntax(state, &state->row[row->idx + 1]);
+    return in_comment;
+}
+
+/**
+ * @brief Calculates the multiline comment state of a row that was not
+ *        rendered yet, by highlighting its chars (or a scratch copy of them,
+ *        if they have a gap).
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the lazily loaded row)
+ * @param in_comment (comment state at the start of the row)
+ * @return int (comment state at the end of the row)
+ */
+static int scan_open_comment(eState *state, erow *row, int in_comment) {
+    static char *scratch = NULL; // copy of the chars around the gap
+    static unsigned char *scratch_hl = NULL;
+    static int scratch_size = 0;
+
+    if (state->syntax == NULL || state->syntax->multiline_comment_start == NULL)
+        return 0;
+
+    if (ROW_SIZE(row) + 1 > scratch_size) {
+        scratch_size = ROW_SIZE(row) + 1;
+        scratch = realloc(scratch, scratch_size);
+        scratch_hl = realloc(scratch_hl, scratch_size);
+    }
+    char *chars = row->chars;
+    if (row->gaplen > 0 && row->gap < ROW_SIZE(row)) { // rows dirty in an edit transaction may have a gap
+        memcpy(scratch, row->chars, row->gap);
+        memcpy(&scratch[row->gap], &row->chars[row->gap + row->gaplen], ROW_SIZE(row) - row->gap);
+        chars = scratch;
+    }
+    in_comment = highlight_line(state, chars, ROW_SIZE(row), scratch_hl, in_comment);
+    if (scratch_size > EDDIE_SCRATCH_KEEP) { // kept only as long as typical rows need
+        free(scratch);
+        free(scratch_hl);
+        scratch = NULL;
+        scratch_hl = NULL;
+        scratch_size = 0;
+    }
+    return in_comment;
+}
+
+/**
+ * @brief Returns the multiline comment state a row starts with. Rows before it
+ *        that were never rendered are scanned to find it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (index of the row)
+ * @return int (whether a multiline comment is open at the start of the row)
+ */
+static int prev_open_comment(eState *state, int at) {
+    int known = at - 1;
+    while (known >= 0 && ROW_OPEN_COMMENT(editorRow(state, known)) == -1)
+        known--;
+
+    int in_comment = (known >= 0) ? ROW_OPEN_COMMENT(editorRow(state, known)) : 0;
+    for (int j = known + 1; j < at; j++) {
+        in_comment = scan_open_comment(state, editorRow(state, j), in_comment);
+        ROW_OPEN_COMMENT(editorRow(state, j)) = in_comment;
+    }
+    return in_comment;
+}
+
+void editorUpdateSyntaxForeground(eState *state, erow *row) {
+    int at = editorRowIndex(state, row);
+    int in_comment = highlight_line(state, editorRowRender(row), row->rd->rsize, row->rd->hl, prev_open_comment(state, at));
+
+    int changed = (ROW_OPEN_COMMENT(row) != in_comment); // marks change that affects next row
+    ROW_OPEN_COMMENT(row) = in_comment;
+    if (changed && at + 1 < state->numrows)
+        editorUpdateSyntax(state, editorRow(state, at + 1));
 }
 
 void editorUpdateSyntax(eState *state, erow *row) {
+    if (ROW_FLAGS(row) & ROW_STALE) { // not rendered yet - only keep its comment state up to date
+        int at = editorRowIndex(state, row);
+        while (ROW_OPEN_COMMENT(row) != -1) {
+            int in_comment = scan_open_comment(state, row, prev_open_comment(state, at));
+            if (in_comment == ROW_OPEN_COMMENT(row) || at + 1 >= state->numrows) {
+                ROW_OPEN_COMMENT(row) = in_comment;
+                return; // no change that affects the next row
+            }
+            ROW_OPEN_COMMENT(row) = in_comment;
+            row = editorRow(state, ++at);
+            if (!(ROW_FLAGS(row) & ROW_STALE)) {
+                editorUpdateSyntax(state, row);
+                return;
+            }
+        }
+        return;
+    }
     editorUpdateSyntaxBackground(row);
     editorUpdateSyntaxForeground(state, row);
 }
@@ -217,7 +326,11 @@ void editorSelectSyntaxHighlight(eState *state) {
 
                 int filerow;
                 for (filerow = 0; filerow < state->numrows; filerow++) {
-                    editorUpdateSyntax(state, &state->row[filerow]);
+                    erow *row = editorRow(state, filerow);
+                    if (ROW_FLAGS(row) & ROW_STALE)
+                        ROW_OPEN_COMMENT(row) = -1; // calculated again when needed
+                    else
+                        editorUpdateSyntax(state, row);
                 }
 
                 return;
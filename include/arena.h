@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "structs.h"
+
+/*** row arena ***/
+
+/**
+ * @brief Copy @len bytes into a new slot of the row arena - the blocks
+ *        holding the text of every inserted or edited row, while unedited
+ *        rows keep pointing into the file mapping. Each row owns its slot,
+ *        edits change it in place; the arena is not an append-only log.
+ *        The slot is null-terminated.
+ *
+ * @param state (pointer to the editor state object)
+ * @param s (the text of the slot)
+ * @param len (length of the text)
+ * @return char* (the text in the arena)
+ */
+char *editorArenaNew(eState *state, const char *s, size_t len);
+
+/**
+ * @brief Make room for @len bytes and a null-terminator in a slot holding
+ *        @size bytes. The slot grows in place when it has room or ends its
+ *        block, otherwise its text moves to a new (larger) slot.
+ *        No background save may read the slot.
+ *
+ * @param state (pointer to the editor state object)
+ * @param chars (the text of the slot)
+ * @param size (number of bytes used in the slot)
+ * @param len (number of bytes needed)
+ * @return char* (the text of the slot, which may have moved)
+ */
+char *editorArenaGrow(eState *state, char *chars, size_t size, size_t len);
+
+/**
+ * @brief Release a slot no row uses anymore. A block is freed once none of
+ *        the slots in it are used, the current block is reused instead.
+ *
+ * @param state (pointer to the editor state object)
+ * @param chars (the text of the slot)
+ */
+void editorArenaRelease(eState *state, char *chars);
+
+#endif
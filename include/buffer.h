@@ -2,9 +2,41 @@
 #define BUFFER_H
 
 #include "consts.h"
+#include "structs.h"
+
+/*** row flags ***/
+#define ROW_MAPPED (1 << 0) // chars point into the file mapping and are not owned by the row
+#define ROW_STALE  (1 << 1) // render details (render, wraps, hl, bg) were not built yet
+#define ROW_SHARED (1 << 2) // chars may be read by a background save and must be copied before edits
+#define ROW_CRLF   (1 << 3) // row ends with \r\n in the file
+#define ROW_DIRTY  (1 << 4) // row was edited in an open edit transaction and is rendered again at its commit
+#define ROW_SEEN   (1 << 5) // row was displayed since the render details were last trimmed
+#define ROW_CUT    (1 << 6) // row is the start of a line longer than EDDIE_MAX_ROW, the rest of it stays in the file mapping
 
 /*** row operations ***/
 
+/**
+ * @brief The character at @at in the text of a row, skipping over the gap.
+ * 
+ * @param row (the row)
+ * @param at (index of the character)
+ * @return char (the character)
+ */
+static inline char editorRowChar(erow *row, int at) {
+    return row->chars[at < row->gap ? at : at + row->gaplen];
+}
+
+/**
+ * @brief The render of a rendered row - its own, or its chars when they are
+ *        shown as they are. The render is not null-terminated.
+ * 
+ * @param row (the rendered row)
+ * @return char* (rd->rsize rendered characters)
+ */
+static inline char *editorRowRender(erow *row) {
+    return row->rd->render ? row->rd->render : row->chars;
+}
+
 /**
  * @brief Convert cursor actual location on row to rendered location
  *        (difference is in tab-space conversion)
@@ -36,6 +68,88 @@ int editorRowRxToCx(erow *row, int rx);
  */
 void editorUpdateRow(eState *state, erow *row);
 
+/**
+ * @brief Builds the render details of a lazily loaded row, if they
+ *        were not built yet (or were built for another screen width).
+ *        Should be called before accessing
+ *        render, wraps, wrap_stops, hl or bg of a row.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row being prepared)
+ */
+void editorPrepareRow(eState *state, erow *row);
+
+/**
+ * @brief Opens an edit transaction. Until the matching editorEditCommit,
+ *        rows the edit operations touch are only marked dirty, instead of
+ *        rendered and highlighted again after each of them - except for a
+ *        single char typed or deleted in a rendered row, which is laid out
+ *        again from the edit on right away. Dirty rows are still built on
+ *        demand by editorPrepareRow. Transactions nest.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorEditBegin(eState *state);
+
+/**
+ * @brief Closes an edit transaction. Closing the outermost one renders and
+ *        highlights every row left dirty once.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorEditCommit(eState *state);
+
+/**
+ * @brief Close the gap edits leave in the chars of a row, for code that
+ *        needs them as one null-terminated string (search, save, splitting
+ *        rows). Rendering reads around the gap instead.
+ * 
+ * @param row (the row)
+ */
+void editorRowFlatten(erow *row);
+
+/**
+ * @brief Gives a row its own writable copy of its chars in the row arena,
+ *        if they point into the file mapping (copy-on-write) or may still be
+ *        read by a background save. Owned chars are null-terminated. A row
+ *        cut short (ROW_CUT) loses the rest of its line, and the file can't
+ *        be saved after - editing such rows is refused before getting here.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row about to be changed)
+ */
+void editorRowOwnChars(eState *state, erow *row);
+
+/**
+ * @brief Length of a row in the saved file, including its line ending - and
+ *        the rest of the line in the file mapping, for a row cut short.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the measured row)
+ * @return size_t (number of bytes the row takes in the file)
+ */
+size_t editorRowFileLen(eState *state, erow *row);
+
+/**
+ * @brief The row at index @at. The pointer stays valid until rows are
+ *        inserted or deleted.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (row index, less than numrows)
+ * @return erow* (the row)
+ */
+erow *editorRow(eState *state, int at);
+
+/**
+ * @brief The index of a row - rows don't keep it, so inserting or
+ *        deleting rows doesn't renumber the rows after them.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ * @return int (row index)
+ */
+int editorRowIndex(eState *state, erow *row);
+
 /**
  * @brief Insert a new row to the editor's buffer.
  * 
@@ -46,6 +160,54 @@ void editorUpdateRow(eState *state, erow *row);
  */
 void editorInsertRow(eState *state, int at, char *s, size_t len);
 
+/**
+ * @brief Size of the row a line of @len bytes is copied into - a line longer
+ *        than EDDIE_MAX_ROW is cut short, and the file can't be saved after.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param len (length of the line)
+ * @return int (size of the row)
+ */
+int editorRowFit(eState *state, size_t len);
+
+/**
+ * @brief Load lines [first, first + count) of an indexed file mapping as
+ *        rows at @at. The lines are not copied and the rows are not rendered
+ *        until they are first used. Loading is not an edit - the rows count
+ *        as unchanged. In windowed mode a line longer than EDDIE_MAX_ROW is
+ *        loaded as a row cut short (ROW_CUT), which shows and searches only
+ *        the start of the line but saves all of it from the mapping. It
+ *        can't be edited.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (insert location - row index)
+ * @param buf (the file mapping)
+ * @param idx (line index of buf)
+ * @param first (first line loaded)
+ * @param count (number of lines loaded)
+ */
+void editorLoadRows(eState *state, int at, char *buf, struct lineidx *idx, long long first, int count);
+
+/**
+ * @brief Unload rows [at, at + count) from the row array, without counting
+ *        it as an edit. Only meant for rows that are unchanged since they
+ *        were loaded, so they can be loaded again from the file mapping.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param at (index of the first row dropped)
+ * @param count (number of rows dropped)
+ */
+void editorDropRows(eState *state, int at, int count);
+
+/**
+ * @brief Frees the render details of a row, to be built again by
+ *        editorPrepareRow when it is next used.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ */
+void editorUnprepareRow(eState *state, erow *row);
+
 
 /**
  * @brief deletes the row in index @at and adjusts the row
@@ -78,6 +240,24 @@ void editorRowInsertChar(eState *state, erow *row, int at, int c);
  */
 void editorRowAppendString(eState *state, erow *row, char *s, size_t len);
 
+/**
+ * @brief Set whether a row ends with CRLF rather than LF in the file.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ * @param crlf (whether the row ends with CRLF)
+ */
+void editorRowSetCrlf(eState *state, erow *row, int crlf);
+
+/**
+ * @brief Cut a row short, dropping every character from column @at onwards.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row being truncated)
+ * @param at (new length of the row)
+ */
+void editorRowTruncate(eState *state, erow *row, int at);
+
 /**
  * @brief Delete a character from the row buffer in column @at.
  * 
@@ -87,6 +267,42 @@ void editorRowAppendString(eState *state, erow *row, char *s, size_t len);
  */
 void editorRowDelChar(eState *state, erow *row, int at);
 
+/**
+ * @brief Sets the width of the numbering column (and the columns left for
+ *        editing) to fit line numbers up to @count.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param count (number of lines in the file, 0 is numbered as a single line)
+ */
+void editorSetLineCount(eState *state, long long count);
+
+/**
+ * @brief Show the memory use of the render details of the rows in the
+ *        status bar - how much the slab allocator took from the system,
+ *        and how much of it is in use.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorShowRowMemory(eState *state);
+
+/**
+ * @brief Keeps the render details of the rows within the budget of
+ *        state->rowbudget. Past it, rows are swept in a circle and the
+ *        render details of those not displayed since the last sweep are
+ *        freed (least recently used first, as a clock does), down to three
+ *        quarters of the budget. Rows on the screen and within a screen of
+ *        the cursor are kept. Each call goes over at most EDDIE_TRIM_STEPS
+ *        rows, a sweep of a large file goes on over the next calls. Once a
+ *        whole sweep (every row twice) can't get down to the target, no
+ *        sweep is started until more rows were rendered, or the memory is
+ *        within the budget again. Called before a row is rendered, so the
+ *        budget holds within a single command too. Freed rows are rendered
+ *        again once they are displayed or searched.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorTrimRowMemory(eState *state);
+
 /*** append buffer ***/
 
 /**
@@ -0,0 +1,93 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "structs.h"
+#include "lineidx.h"
+
+struct cacheWriter;
+
+/*** open cache ***/
+
+/**
+ * @brief Look up the open cache entry of the file - kept under
+ *        $XDG_CACHE_HOME/eddie (~/.cache/eddie by default), keyed by the
+ *        path, size and modification time of the file. If there is an
+ *        entry for the file as it is on disk, its line index is read into
+ *        @idx instead of indexing the file, and its multiline comment
+ *        checkpoints are kept for editorCacheCheckpoint.
+ *
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param idx (the index to fill, should be empty)
+ * @return int (returns -1 if the file has no cache entry, otherwise 0)
+ */
+int editorCacheLoad(eState *state, int fd, struct lineidx *idx);
+
+/**
+ * @brief Start a new cache entry for the file, its line index is written
+ *        as the file is indexed. The entry gets comment checkpoints once
+ *        the file is closed.
+ *
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @return struct cacheWriter* (the entry being written, NULL if it can't be)
+ */
+struct cacheWriter *editorCacheWriteStart(eState *state, int fd);
+
+/**
+ * @brief Write the line offsets of the next indexed part of the file to
+ *        the entry - safe to call from the loader thread.
+ *
+ * @param w (the entry being written, may be NULL)
+ * @param chunk (the index of the part)
+ * @param base (offset of the part in the file)
+ */
+void editorCacheWriteLines(struct cacheWriter *w, struct lineidx *chunk, size_t base);
+
+/**
+ * @brief Finish the entry once the whole file is indexed - it is only kept
+ *        if the file didn't change since it was opened. Safe to call from
+ *        the loader thread.
+ *
+ * @param w (the entry being written, may be NULL)
+ * @param fd (descriptor of the open file)
+ */
+void editorCacheWriteEnd(struct cacheWriter *w, int fd);
+
+/**
+ * @brief Make a finished entry the cache entry of the open file (if it
+ *        was kept), and free the writer.
+ *
+ * @param state (pointer to the editor state object)
+ * @param w (the finished entry, may be NULL)
+ */
+void editorCacheWriteAdopt(eState *state, struct cacheWriter *w);
+
+/**
+ * @brief The multiline comment state at the end of line @line, if the cache
+ *        has a checkpoint for it.
+ *
+ * @param state (pointer to the editor state object)
+ * @param line (line number in the file)
+ * @return int (the comment state, -1 if unknown)
+ */
+int editorCacheCheckpoint(eState *state, long long line);
+
+/**
+ * @brief Forget the cache entry of the file - it no longer describes the
+ *        rows once they are edited, or the file once it changed on disk.
+ *
+ * @param state (pointer to the editor state object)
+ */
+void editorCacheDrop(eState *state);
+
+/**
+ * @brief Add the comment checkpoints of the rows highlighted so far to the
+ *        cache entry of the file (if the file didn't change since it was
+ *        opened), and forget the entry.
+ *
+ * @param state (pointer to the editor state object)
+ */
+void editorCacheClose(eState *state);
+
+#endif
@@ -26,6 +26,26 @@
 #define MSG_TIMEOUT 5 // seconds
 #define EDDIE_QUIT_TIMES 3 // times to check when exiting without saving
 #define DO_SOFTWRAP
+#define EDDIE_MMAP_THRESHOLD (1 << 20) // files this large (bytes) are opened memory-mapped
+#define EDDIE_SAVE_IOV_BATCH 1024 // regions gathered into each writev call when saving
+#define EDDIE_TAIL_SAVE_THRESHOLD (16 << 20) // files this large (bytes) are saved by rewriting only their modified tail
+#define EDDIE_WINDOW_THRESHOLD (256 << 20) // files this large (bytes) only keep a window of rows around the cursor loaded
+#define EDDIE_WINDOW_ROWS 4096 // rows kept loaded on each side of the cursor in windowed mode
+#define EDDIE_INDEX_THREADS 16 // most threads indexing the lines of a file in parallel
+#define EDDIE_INDEX_SLICE (32 << 20) // least bytes indexed by each of those threads
+#define EDDIE_JOURNAL_BATCH (64 << 10) // journaled edits (bytes) buffered before they are written and synced
+#define EDDIE_JOURNAL_INTERVAL 1 // most seconds journaled edits wait to be synced while typing
+#define EDDIE_PIPE_BATCH (4 << 20) // most bytes read from a piped input between two screen updates
+#define EDDIE_LOAD_FIRST (64 << 10) // bytes of a mapped file loaded before the first screen, the rest loads in the background
+#define EDDIE_CACHE_CHECKPOINT 1024 // rows between two multiline comment states kept in the open cache
+#define EDDIE_ARENA_BLOCK (1 << 20) // least bytes of each block of the row arena, which holds the text of edited rows
+#define EDDIE_ROW_CHUNK (16 << 10) // bytes of each chunk of the row index (a power of two), the rows in it with their fields
+#define EDDIE_SLAB_SIZE (256 << 10) // bytes of each slab the render details of rows are carved out of (a power of two)
+#define EDDIE_SCRATCH_KEEP (64 << 10) // most bytes of a scratch copy kept between two layouts or scans, larger ones are freed after use
+#define EDDIE_ROW_GAP 64 // least bytes of room opened at the cursor of a row being typed into
+#define EDDIE_MAX_ROW (INT_MAX / (2 * EDDIE_TAB_STOP)) // most bytes of a line loaded as a row, so its render (and room for it to grow) fits an int - longer lines are cut short
+#define EDDIE_ROW_MEMORY_BUDGET (64 << 20) // most bytes of render details kept unless EDDIE_ROW_MEMORY sets it, those of rows not displayed lately are freed past it
+#define EDDIE_TRIM_STEPS 4096 // most rows a sweep trimming render details goes over in one call, a longer sweep goes on in the next ones
 
 /*** Keyboard ***/
 
@@ -41,7 +61,8 @@ enum editorKey {
     HOME_KEY,
     END_KEY,
     PAGE_UP,
-    PAGE_DOWN
+    PAGE_DOWN,
+    NO_KEY // no key was pressed before the read timeout
 };
 
 /*** ANSI Escape Codes ***/
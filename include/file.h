@@ -11,12 +11,127 @@
  */
 void editorOpen(eState *estate, char *filename);
 
+/**
+ * @brief Start reading rows from a pipe - the rows are read as the data
+ *        arrives by editorPipePoll, the editor doesn't wait for all of it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (the read end of the pipe)
+ */
+void editorOpenPipe(eState *state, int fd);
+
+/**
+ * @brief Reads what arrived on the pipe (up to EDDIE_PIPE_BATCH bytes), and
+ *        inserts its complete lines as rows after the last one - a line is
+ *        only shown once its newline arrives, or the pipe is closed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether rows were added - the screen should be redrawn)
+ */
+int editorPipePoll(eState *state);
+
+/**
+ * @brief Read the open file again after it was truncated or replaced on
+ *        disk - the file is indexed again, and only mapped or read in full
+ *        as a file that size is when opened. Any edits are discarded.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (returns -1 if the file can't be read, otherwise 0)
+ */
+int editorReload(eState *state);
+
+/**
+ * @brief Load the lines appended to the open file since it was last read
+ *        or written - only the new bytes are read, and inserted as rows
+ *        after the last one (the appended rows don't count as edits).
+ *        A last line that had no newline is continued by them.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param size (new size of the file)
+ * @return int (returns -1 on read error, otherwise 0)
+ */
+int editorReadAppended(eState *state, int fd, off_t size);
+
 /**
  * @brief Save the current open file in place. If no file was open,
  *        prompts the user to "save as".
+ *        The rows are snapshotted and written by a background thread,
+ *        completion is reported by editorSavePoll.
  * 
  * @param state (pointer to the editor state object)
  */
 void editorSave(eState *state);
 
+/**
+ * @brief Checks whether the background save finished, and if so reports
+ *        the result in the status bar and marks the file as saved (unless
+ *        it was edited after the snapshot was taken).
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether a save finished - the screen should be redrawn)
+ */
+int editorSavePoll(eState *state);
+
+/**
+ * @brief Blocks until the background save (if any) finishes, and reports it.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorSaveWait(eState *state);
+
+/**
+ * @brief Load the rest of the mapped file in the background - its first
+ *        lines are loaded right away, the others are indexed by a loader
+ *        thread in chunks of growing size and loaded as they come in
+ *        (into the rows, or into the window index in windowed mode).
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ */
+void editorLoadStart(eState *state, int fd);
+
+/**
+ * @brief Load the lines indexed by the background loader since the last
+ *        poll, and finish the load once the whole file is indexed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether any rows were loaded)
+ */
+int editorLoadPoll(eState *state);
+
+/**
+ * @brief Wait for the background load to finish, if any - before edits,
+ *        which have to go into the rows of the whole file.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorLoadWait(eState *state);
+
+/**
+ * @brief How far the background load got.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (percentage of the file loaded, -1 if no load is in progress)
+ */
+int editorLoadProgress(eState *state);
+
+/**
+ * @brief Hands row storage that was replaced during a background save
+ *        over to the save, which releases it once it no longer reads it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param chars (the replaced row storage)
+ */
+void editorSaveKeep(eState *state, char *chars);
+
+/**
+ * @brief Formats a byte count with a binary unit suffix (B, KB, MB...)
+ * 
+ * @param buf (target string buffer)
+ * @param buflen (size of buf)
+ * @param bytes (the byte count)
+ */
+void editorFormatSize(char *buf, size_t buflen, double bytes);
+
 #endif
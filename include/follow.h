@@ -0,0 +1,37 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "structs.h"
+
+/*** follow mode ***/
+
+/**
+ * @brief Turn follow mode on or off - like `tail -f`, the open file is
+ *        watched with inotify, and the lines other processes append to it
+ *        are loaded as they come in.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorFollowToggle(eState *state);
+
+/**
+ * @brief Checks whether the followed file changed on disk: appended lines
+ *        are loaded (and scrolled to, if the cursor was on the last row),
+ *        and a file that was truncated or replaced is indexed again.
+ *        Does nothing while a save is in progress.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (whether the file changed - the screen should be redrawn)
+ */
+int editorFollowPoll(eState *state);
+
+/**
+ * @brief Tells follow mode the file was just saved by the editor itself,
+ *        so that the save isn't taken for a change made by someone else -
+ *        the pending events are dropped, and the saved file is watched.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorFollowSaved(eState *state);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "structs.h"
+
+/*** edit journal ***/
+
+/**
+ * @brief The primitive edits recorded in the journal, one per row operation
+ *        of buffer.c.
+ */
+enum journalOp {
+    JOURNAL_INSERT_ROW = 1,
+    JOURNAL_DEL_ROW,
+    JOURNAL_INSERT_CHAR,
+    JOURNAL_DEL_CHAR,
+    JOURNAL_APPEND_STRING,
+    JOURNAL_TRUNCATE,
+    JOURNAL_CRLF
+};
+
+/**
+ * @brief Start journaling the edits of the open file, into a hidden
+ *        .<name>.journal file next to it. A journal left behind by a
+ *        session that didn't quit is replayed on top of the file first -
+ *        as long as it was written for the file as it is on disk now.
+ *        A journal another editor still writes to is left alone.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorJournalOpen(eState *state);
+
+/**
+ * @brief Record a primitive edit in the journal. The records are buffered,
+ *        and group-committed (written and synced at once) when the editor
+ *        goes idle, the buffer fills up, or the last sync got too old.
+ *        Does nothing when no journal is open.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param op (the edit)
+ * @param at (index of the edited row in the row array)
+ * @param pos (column of the edit in the row, 0 if not used)
+ * @param s (the inserted characters, NULL if none)
+ * @param len (length of s)
+ */
+void editorJournalRecord(eState *state, enum journalOp op, int at, int pos, const char *s, int len);
+
+/**
+ * @brief Write and sync the buffered journal records, if any.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorJournalCommit(eState *state);
+
+/**
+ * @brief The current end of the journal, to tell the edits recorded before
+ *        it apart from the later ones in editorJournalRebase.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return off_t (length of the recorded edits)
+ */
+off_t editorJournalMark(eState *state);
+
+/**
+ * @brief Start the journal over from the file as it is on disk now - the
+ *        edits recorded before @mark are in the file, only the later ones
+ *        are kept. The journal is replaced atomically.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param mark (end of the edits that are in the file, from editorJournalMark)
+ */
+void editorJournalRebase(eState *state, off_t mark);
+
+/**
+ * @brief Stop journaling and delete the journal - when quitting, the
+ *        edits are either saved or meant to be discarded.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorJournalClose(eState *state);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef LINEIDX_H
+#define LINEIDX_H
+
+#include "syshead.h"
+
+/**
+ * @brief Offsets of the lines in a buffer, as found by a single
+ *        scan for newlines.
+ *        Line i spans [off[i], off[i + 1] - 1) - the newline is not included.
+ *        off[count] is one past the newline of the last line (a missing
+ *        newline at the end of the buffer is counted as if it was there).
+ *        The offsets are kept on the heap, or in a file mapping when fd is
+ *        set before building, so the kernel can page them out.
+ * 
+ * {
+ *      size_t *off; (array of count + 1 line start offsets)
+ *      long long count; (number of lines)
+ *      long long cap; (number of offsets allocated)
+ *      int fd; (file backing the offsets array, -1 to keep it on the heap)
+ * }
+ */
+struct lineidx {
+    size_t *off;
+    long long count;
+    long long cap;
+    int fd;
+};
+
+#define LINEIDX_INIT \
+    { NULL, 0, 0, -1 }
+
+/**
+ * @brief Index the lines of a buffer with a vectorized scan (AVX2 or
+ *        SSE2 when the cpu has them, portable fallback otherwise).
+ *        Large buffers are split into slices indexed by a thread each.
+ * 
+ * @param idx (the index to fill, should be empty)
+ * @param buf (the buffer being indexed)
+ * @param size (size of the buffer)
+ */
+void lineIndexBuild(struct lineidx *idx, const char *buf, size_t size);
+
+/**
+ * @brief Index the lines of buf[from, size) that were appended to the
+ *        already indexed buf[0, from) - an unterminated last line is
+ *        continued by the appended bytes.
+ * 
+ * @param idx (the index of buf[0, from))
+ * @param buf (the buffer being indexed)
+ * @param from (size of the already indexed part)
+ * @param size (size of the buffer)
+ */
+void lineIndexExtend(struct lineidx *idx, const char *buf, size_t from, size_t size);
+
+/**
+ * @brief Append the lines of another index, of the part of the buffer that
+ *        starts at offset @base - right where the lines of @idx end.
+ * 
+ * @param idx (the index appended to, may be empty)
+ * @param src (the index of the following part)
+ * @param base (offset of the part indexed by src in the buffer)
+ */
+void lineIndexAppend(struct lineidx *idx, struct lineidx *src, size_t base);
+
+/**
+ * @brief Length of line @at in the indexed buffer, without its newline.
+ * 
+ * @param idx (the line index)
+ * @param at (line number)
+ * @return size_t (length of the line)
+ */
+size_t lineIndexLen(struct lineidx *idx, long long at);
+
+/**
+ * @brief Find the line containing offset @off of the indexed buffer.
+ * 
+ * @param idx (the line index)
+ * @param off (offset into the buffer)
+ * @return long long (line number)
+ */
+long long lineIndexFind(struct lineidx *idx, size_t off);
+
+/**
+ * @brief Replace lines [first, last) of the index with @count lines of the
+ *        given lengths, shifting the offsets of the lines after them.
+ * 
+ * @param idx (the line index)
+ * @param first (first replaced line)
+ * @param last (line after the last replaced line)
+ * @param lens (lengths of the new lines, including their newlines)
+ * @param count (number of new lines)
+ */
+void lineIndexSplice(struct lineidx *idx, long long first, long long last, const size_t *lens, int count);
+
+/**
+ * @brief Read the offsets of @count lines into an empty index, from a file
+ *        they were written to by lineIndexWrite.
+ * 
+ * @param idx (the index to fill, should be empty)
+ * @param fd (descriptor of the file)
+ * @param offset (file offset of the offsets)
+ * @param count (number of lines)
+ * @return int (returns -1 on read error, otherwise 0)
+ */
+int lineIndexRead(struct lineidx *idx, int fd, off_t offset, long long count);
+
+/**
+ * @brief Write the offsets of the index to a file.
+ * 
+ * @param idx (the line index)
+ * @param fd (descriptor of the file)
+ * @param offset (file offset to write the offsets at)
+ * @return int (returns -1 on write error, otherwise 0)
+ */
+int lineIndexWrite(struct lineidx *idx, int fd, off_t offset);
+
+/**
+ * @brief free a line index (frees the offsets array, closes its backing
+ *        file and sets count to 0, does not free the struct)
+ * 
+ * @param idx (the line index)
+ */
+void lineIndexFree(struct lineidx *idx);
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef ROWIDX_H
+#define ROWIDX_H
+
+#include "consts.h"
+#include "structs.h"
+
+// rows in each chunk - as many as fit EDDIE_ROW_CHUNK bytes with their fields, past the chunk head and malloc's own
+#define ROW_CHUNK_ROWS ((EDDIE_ROW_CHUNK - 64) / (sizeof(erow) + 2 * sizeof(int) + 2))
+
+/**
+ * @brief A run of consecutive rows, EDDIE_ROW_CHUNK bytes aligned - so the
+ *        chunk of a row is found by masking its address. The small fields
+ *        of the rows, which scans over many rows read, are kept in arrays of
+ *        their own next to the rows (which keep their pointers), so those
+ *        scans don't load the rest of the rows. See ROW_SIZE and the like.
+ *
+ * {
+ *      int count; (number of rows in the chunk)
+ *      int slot; (position of the chunk in the index)
+ *      int lines; (number of screen rows the rows take - one plus their wraps each)
+ *      erow rows[]; (the rows)
+ *      int size[]; (size of chars array of each row)
+ *      int wraps[]; (number of wraps in each row)
+ *      signed char open_comment[]; (whether each row has an open multiline comment, -1 if not calculated yet)
+ *      unsigned char flags[]; (row state flags of each row - ROW_MAPPED, ROW_STALE, ROW_SHARED, ROW_CRLF...)
+ * }
+ */
+struct rowChunk {
+    int count;
+    int slot;
+    int lines;
+    erow rows[ROW_CHUNK_ROWS];
+    int size[ROW_CHUNK_ROWS];
+    int wraps[ROW_CHUNK_ROWS];
+    signed char open_comment[ROW_CHUNK_ROWS];
+    unsigned char flags[ROW_CHUNK_ROWS];
+};
+
+/**
+ * @brief The chunk a row is in.
+ *
+ * @param row (the row)
+ * @return struct rowChunk* (the chunk)
+ */
+static inline struct rowChunk *rowChunkOf(erow *row) {
+    return (struct rowChunk *)((uintptr_t)row & ~(uintptr_t)(EDDIE_ROW_CHUNK - 1));
+}
+
+/**
+ * @brief The size of a row, see ROW_SIZE.
+ *
+ * @param row (the row)
+ * @return int* (the field in the array of its chunk)
+ */
+static inline int *rowSizeOf(erow *row) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    return &chunk->size[row - chunk->rows];
+}
+
+/**
+ * @brief The number of wraps of a row, see ROW_WRAPS.
+ *
+ * @param row (the row)
+ * @return int* (the field in the array of its chunk)
+ */
+static inline int *rowWrapsOf(erow *row) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    return &chunk->wraps[row - chunk->rows];
+}
+
+/**
+ * @brief The multiline comment state of a row, see ROW_OPEN_COMMENT.
+ *
+ * @param row (the row)
+ * @return signed char* (the field in the array of its chunk)
+ */
+static inline signed char *rowOpenCommentOf(erow *row) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    return &chunk->open_comment[row - chunk->rows];
+}
+
+/**
+ * @brief The state flags of a row, see ROW_FLAGS.
+ *
+ * @param row (the row)
+ * @return unsigned char* (the field in the array of its chunk)
+ */
+static inline unsigned char *rowFlagsOf(erow *row) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    return &chunk->flags[row - chunk->rows];
+}
+
+// the fields of a row kept in the arrays of its chunk, as lvalues
+#define ROW_SIZE(row) (*rowSizeOf(row))
+#define ROW_WRAPS(row) (*rowWrapsOf(row))
+#define ROW_OPEN_COMMENT(row) (*rowOpenCommentOf(row))
+#define ROW_FLAGS(row) (*rowFlagsOf(row))
+
+/**
+ * @brief The rows of the editor, kept in chunks of up to ROW_CHUNK_ROWS
+ *        rows. A Fenwick tree over the sizes of the chunks finds the chunk
+ *        of a row number in O(log n), so inserting or deleting rows only
+ *        shifts the rows of one chunk. Rows don't keep their number - it
+ *        follows from the chunk they are in.
+ *        A second Fenwick tree over the screen rows of the chunks maps
+ *        between row numbers and screen rows (one plus the wraps of a row),
+ *        with a scan of a single chunk.
+ *        Row pointers stay valid until rows are inserted or deleted.
+ *        An all zero struct is an empty index.
+ *        Splitting or removing a chunk shifts the chunk pointers after it
+ *        and builds their Fenwick entries again, O(n / ROW_CHUNK_ROWS).
+ *        A chunk is only split or removed after at least ROW_CHUNK_ROWS / 2
+ *        rows were inserted into it or deleted from it since it was made
+ *        (split chunks start half full, appended ones full, and the last
+ *        chunk is rebuilt in O(1)), so inserting or deleting a row costs
+ *        O(log n + ROW_CHUNK_ROWS + n / ROW_CHUNK_ROWS^2) amortized.
+ *
+ * {
+ *      struct rowChunk **chunks; (the chunks, in row order)
+ *      int nchunks; (number of chunks)
+ *      int cap; (number of chunk pointers allocated)
+ *      int *tree; (Fenwick tree of the chunk sizes, 1-based)
+ *      long long *lines; (Fenwick tree of the screen rows of the chunks, 1-based)
+ *      int count; (number of rows)
+ *      struct rowChunk *last; (chunk of the last row looked up, NULL if the rows moved since)
+ *      int lastfirst; (number of the first row in that chunk)
+ * }
+ */
+struct rowidx {
+    struct rowChunk **chunks;
+    int nchunks;
+    int cap;
+    int *tree;
+    long long *lines;
+    int count;
+    struct rowChunk *last;
+    int lastfirst;
+};
+
+/**
+ * @brief The row with number @at. Going through the rows in order only
+ *        looks up the chunk once for every chunk.
+ *
+ * @param idx (the row index)
+ * @param at (row number, less than the number of rows)
+ * @return erow* (the row)
+ */
+erow *rowIndexGet(struct rowidx *idx, int at);
+
+/**
+ * @brief The number of a row in the index.
+ *
+ * @param idx (the row index)
+ * @param row (the row)
+ * @return int (row number)
+ */
+int rowIndexOf(struct rowidx *idx, erow *row);
+
+/**
+ * @brief Open @count slots for new rows before row @at, shifting the
+ *        following rows. The new rows are counted as one screen row each
+ *        (their wraps are set to 0), the rest of them is left to the caller.
+ *        A chunk that overflows is split into even parts, unless the slots
+ *        are appended to it - then the chunks are filled up in turn.
+ *
+ * @param idx (the row index)
+ * @param at (number of the first new row)
+ * @param count (number of rows inserted)
+ */
+void rowIndexInsert(struct rowidx *idx, int at, int count);
+
+/**
+ * @brief Remove the slots of rows [at, at + count), shifting the following
+ *        rows back. The rows should be freed already, with their wraps
+ *        left as they were counted.
+ *
+ * @param idx (the row index)
+ * @param at (number of the first removed row)
+ * @param count (number of rows removed)
+ */
+void rowIndexRemove(struct rowidx *idx, int at, int count);
+
+/**
+ * @brief Changes the number of screen rows a row is counted with, when
+ *        its wraps change.
+ *
+ * @param idx (the row index)
+ * @param row (the row)
+ * @param delta (number of screen rows added, negative if removed)
+ */
+void rowIndexAddLines(struct rowidx *idx, erow *row, int delta);
+
+/**
+ * @brief The screen row row @at starts at, counting from the first row.
+ *
+ * @param idx (the row index)
+ * @param at (row number, up to the number of rows)
+ * @return long long (number of screen rows before the row)
+ */
+long long rowIndexLine(struct rowidx *idx, int at);
+
+/**
+ * @brief The row shown on screen row @line, counting from the first row.
+ *
+ * @param idx (the row index)
+ * @param line (screen row)
+ * @param wrap (set to the wrap of the row on the screen row)
+ * @return int (row number, the number of rows if @line is past the last row)
+ */
+int rowIndexAtLine(struct rowidx *idx, long long line, int *wrap);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "syshead.h"
+
+/**
+ * @brief Memory use of the slab allocator.
+ *
+ * {
+ *      size_t slabs; (number of slabs and large blocks allocated)
+ *      size_t reserved; (bytes taken from the system for them)
+ *      size_t used; (bytes of the blocks handed out)
+ * }
+ */
+struct slabStats {
+    size_t slabs;
+    size_t reserved;
+    size_t used;
+};
+
+/*** slab allocator ***/
+
+/**
+ * @brief Allocate a block for row storage (render, highlight and wrap
+ *        arrays). Small blocks are rounded up to a power of two size class
+ *        and carved out of EDDIE_SLAB_SIZE slabs, larger ones get their own.
+ *        Only to be used from the main thread.
+ *
+ * @param size (number of bytes)
+ * @return void* (the block)
+ */
+void *slabAlloc(size_t size);
+
+/**
+ * @brief Resize a block allocated with slabAlloc. The block stays in place
+ *        while it fits its size class - a large block that has to move
+ *        grows by half again at least.
+ *
+ * @param ptr (the block, NULL to allocate a new one)
+ * @param size (new number of bytes)
+ * @return void* (the block, which may have moved)
+ */
+void *slabRealloc(void *ptr, size_t size);
+
+/**
+ * @brief Free a block allocated with slabAlloc. A slab is given back to the
+ *        system once all its blocks are free, except for one kept for reuse
+ *        in every size class.
+ *
+ * @param ptr (the block, may be NULL)
+ */
+void slabFree(void *ptr);
+
+/**
+ * @brief Get the memory use of the allocator.
+ *
+ * @param stats (filled in with the current numbers)
+ */
+void slabGetStats(struct slabStats *stats);
+
+#endif
@@ -5,6 +5,17 @@
 
 #define STATUS_MSG_LEN 80
 
+struct saveJob;
+struct lineidx;
+struct followWatch;
+struct journal;
+struct pipeInput;
+struct fileCache;
+struct fileLoader;
+struct arenaBlock;
+struct rowChunk;
+struct rowidx;
+
 /**
  * @brief contains the syntax highlighting information for a certain filetype
  * 
@@ -28,32 +39,54 @@ struct editorSyntax {
 };
 
 /**
- * @brief struct for holding a displayed row in the editor.
+ * @brief The render details of a row, built from its chars once the row is
+ *        displayed. Kept apart from the row, so going through the rows of a
+ *        large file only reads their (smaller) structs.
+ *        The render and both highlight arrays are packed after the struct in
+ *        a single block, one after the other, which only moves when the row
+ *        grows past its capacity. A row without tabs or wraps is shown
+ *        straight from its chars, and the block holds no render at all.
  * 
  * {
- *      int idx; (index in the file)
- *      int size; (size of chars array)
  *      int rsize; (size of render array)
- *      int wraps; (number of wraps in the row)
+ *      int cap; (number of bytes each of render, hl and bg has room for)
+ *      int cols; (width of the screen the row was laid out for)
  *      int *wrap_stops; (array with the location the row wraps on)
- *      char *chars; (the actual character content of the row)
- *      char *render; (the rendered content of the row)
- *      unsigned char *hl; (foreground syntax highlight code array)
- *      unsigned char *bg; (background syntax highlight code array)
- *      int hl_open_comment; (whether the row has an open multiline comment)
+ *      char *render; (the rendered content of the row, at the start of data - NULL when it is the chars, see editorRowRender)
+ *      unsigned char *hl; (foreground syntax highlight code array, after render)
+ *      unsigned char *bg; (background syntax highlight code array, after hl)
+ *      char data[]; (room for render (if any), hl and bg)
  * }
  */
-typedef struct erow {
-    int idx;
-    int size;
+typedef struct erender {
     int rsize;
-    int wraps;
+    int cap;
+    int cols;
     int *wrap_stops;
-    char *chars;
     char *render;
     unsigned char *hl;
     unsigned char *bg;
-    int hl_open_comment;
+    char data[];
+} erender;
+
+/**
+ * @brief struct for holding a displayed row in the editor. Its size,
+ *        wraps, multiline comment state and flags are kept in arrays of the
+ *        chunk of the row index it is in - see ROW_SIZE, ROW_WRAPS,
+ *        ROW_OPEN_COMMENT and ROW_FLAGS in rowidx.h.
+ * 
+ * {
+ *      char *chars; (the actual character content of the row, in the file mapping or the row arena)
+ *      erender *rd; (render details of the row, NULL while it is not rendered)
+ *      int gap; (start of the gap in chars, where the last edit of the row was)
+ *      int gaplen; (length of the gap, 0 if chars is one contiguous string)
+ * }
+ */
+typedef struct erow {
+    char *chars;
+    erender *rd;
+    int gap;
+    int gaplen;
 } erow;
 
 /**
@@ -71,12 +104,36 @@ typedef struct erow {
  *      int editcols; (number of columns in the editing window - excluding numbering column e.g)
  *      int linenum_w; (width of numbering column)
  *      int numrows; (number of rows in the file)
- *      erow *row; (pointer to row array)
+ *      struct rowidx *rows; (the rows, looked up by index with editorRow)
+ *      char *map; (memory mapping of the open file, if it was opened mapped)
+ *      size_t mapsize; (size of the memory mapping)
+ *      int map_current; (whether the mapping is still the file on disk - no save replaced it)
+ *      int gzip; (whether the file is gzip compressed - it is saved compressed as well)
+ *      struct lineidx *lines; (line index of the mapping in windowed mode, NULL if the whole file is loaded)
+ *      long long winfirst, winlast; (lines [winfirst, winlast) of the mapping are loaded in the row array)
+ *      int winhead, wintail; (number of rows at the start / end of the row array unchanged since loaded)
  *      int dirty; (whether the file was modified since opening)
+ *      int modrow; (first row modified since the file was last read or written - rows before it are unchanged on disk)
+ *      off_t modoff; (offset of modrow in the file on disk, -1 if the whole file has to be rewritten)
+ *      off_t disksize; (size of the file on disk)
+ *      int cut; (whether a line longer than EDDIE_MAX_ROW was copied cut short - the file can't be saved then)
  *      char *filename; (name of the open file)
  *      char statusmsg[STATUS_MSG_LEN]; (last set status message)
  *      time_t statusmsg_time; (time the status message was last set)
  *      struct editorSyntax *syntax; (syntax highlighting struct)
+ *      struct saveJob *save; (background save in progress, NULL if none)
+ *      struct followWatch *follow; (watch on the open file in follow mode, NULL if not following)
+ *      struct journal *journal; (journal the edits are recorded in, NULL if not journaling)
+ *      struct pipeInput *input; (pipe the rows are still being read from, NULL if none)
+ *      struct fileCache *cache; (open cache entry of the unchanged file, NULL if none)
+ *      struct fileLoader *load; (background load of the open file in progress, NULL if none)
+ *      struct arenaBlock *arena; (block of the row arena new row text is taken from, NULL if none yet)
+ *      int edits; (number of open edit transactions)
+ *      int editfirst, editlast; (rows [editfirst, editlast] hold the rows left dirty by the open transactions)
+ *      size_t rowbudget; (most bytes of render details kept, set from EDDIE_ROW_MEMORY at startup)
+ *      int trimhand; (row the next sweep trimming render details starts from)
+ *      long long trimswept; (rows the sweep in progress went over so far)
+ *      size_t trimfloor; (render details memory below which no sweep is started, 0 once it is within the budget again)
  *  }
  */
 typedef struct editor_state {
@@ -92,12 +149,36 @@ typedef struct editor_state {
     int editcols;
     int linenum_w;
     int numrows;
-    erow *row;
+    struct rowidx *rows;
+    char *map;
+    size_t mapsize;
+    int map_current;
+    int gzip;
+    struct lineidx *lines;
+    long long winfirst, winlast;
+    int winhead, wintail;
     int dirty;
+    int modrow;
+    off_t modoff;
+    off_t disksize;
+    int cut;
     char *filename;
     char statusmsg[STATUS_MSG_LEN];
     time_t statusmsg_time;
     struct editorSyntax *syntax;
+    struct saveJob *save;
+    struct followWatch *follow;
+    struct journal *journal;
+    struct pipeInput *input;
+    struct fileCache *cache;
+    struct fileLoader *load;
+    struct arenaBlock *arena;
+    int edits;
+    int editfirst, editlast;
+    size_t rowbudget;
+    int trimhand;
+    long long trimswept;
+    size_t trimfloor;
 } eState;
 
 #endif
\ No newline at end of file
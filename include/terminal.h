@@ -20,6 +20,15 @@ void die(const char *s);
  */
 void disableRawMode();
 
+/**
+ * @brief Moves a piped standard input to a new descriptor, and reopens
+ *        standard input on the controlling terminal, so keys are still
+ *        read (and raw mode set) through it.
+ * 
+ * @return int (descriptor of the piped input, -1 if standard input is the terminal)
+ */
+int editorStdinFromTty();
+
 /**
  * @brief Save current terminal config and enter raw mode
  * 
@@ -29,10 +38,20 @@ void enableRawMode();
 /**
  * @brief user key input processing function (processes escape sequences)
  * 
- * @return int (the processed keypress code)
+ * @return int (the processed keypress code, NO_KEY if no key was pressed before the read timeout)
  */
 int editorReadKey();
 
+/**
+ * @brief Waits for a keypress, checking on background work (like a
+ *        background save) whenever the read times out.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return int (the processed keypress code, NO_KEY if background work
+ *              changed the editor state and the screen should be redrawn)
+ */
+int editorWaitKey(eState *state);
+
 /**
  * @brief Gets the current cursor position on the screen (not relative to the file)
  * 
@@ -149,7 +168,8 @@ void editorSetStatusMessage(eState *state, const char *fmt, ...);
 char *editorPrompt(eState *state, char *prompt, void (*callback)(eState *, char *, int));
 
 /**
- * @brief Handle arrow keypresses and move cursor accordingly.
+ * @brief Handle arrow keypresses and move cursor accordingly - left and
+ *        right by a char, up and down by a screen row (through the wraps).
  * 
  * @param state (pointer to the editor state object)
  * @param key (the direction key code, as defined in the enum editorKey)
@@ -166,6 +186,18 @@ void editorMoveCursor(eState *state, int key);
  */
 void editorStepCursor(eState *state, int key, int steps);
 
+/**
+ * @brief Puts the cursor on column @cx of row @cy directly, with the wrap it
+ *        lands on - a column on a wrap stop is at the end of the wrap before
+ *        it. Only that row and the displayed rows above it are rendered,
+ *        not the rows between them - scrolling is left for editorScroll.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param cy (row index)
+ * @param cx (column in the row)
+ */
+void editorSetCursor(eState *state, int cy, int cx);
+
 /**
  * @brief Handle user keypresses (after low level processing)
  * 
@@ -0,0 +1,98 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "structs.h"
+
+/*** windowed mode ***/
+
+/**
+ * @brief Open a large file in windowed mode - the file is mapped and its
+ *        lines are indexed into a temporary file (so the kernel can page
+ *        the index out too), and only a window of rows around the cursor
+ *        is kept in the row array.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param size (size of the file in bytes)
+ * @return int (returns -1 if the file could not be mapped, otherwise 0)
+ */
+int editorWindowOpen(eState *state, int fd, size_t size);
+
+/**
+ * @brief Slide the window of loaded rows along with the cursor - loads
+ *        rows once the cursor gets near the edge of the window, and drops
+ *        the unchanged rows that got far behind it. Edited rows are never
+ *        dropped, only their render details are freed.
+ *        Does nothing outside windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorWindowFollow(eState *state);
+
+/**
+ * @brief Search the part of the file outside the loaded window for @query,
+ *        and move the window to the match - forwards from the end of the
+ *        window wrapping around to its start, or backwards the other way.
+ *        The window only moves if it has no edits.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param query (the searched string)
+ * @param direction (1 to search forwards, -1 backwards)
+ * @return int (row index of the match in the moved window, -1 if none)
+ */
+int editorWindowFind(eState *state, const char *query, int direction);
+
+/**
+ * @brief Replace the window with the rows around line @line of the file,
+ *        and put the cursor on the first of them.
+ *        Only possible when no row in the window was changed.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param line (the line moved to)
+ * @return int (returns -1 if the window has edits, otherwise 0)
+ */
+int editorWindowGoto(eState *state, long long line);
+
+/**
+ * @brief Grow the window until it holds line @line of the file (as
+ *        numbered with the edits so far), without dropping any rows.
+ *        Does nothing outside windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param line (the line reached)
+ */
+void editorWindowReach(eState *state, long long line);
+
+/**
+ * @brief Take in the lines appended to the file in windowed mode - the
+ *        file is mapped again at its new size and only the appended bytes
+ *        are indexed. If the window reaches the end of the file, the new
+ *        lines are loaded into it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the open file)
+ * @param size (new size of the file)
+ * @return int (returns -1 if the file could not be mapped, otherwise 0)
+ */
+int editorWindowExtend(eState *state, int fd, size_t size);
+
+/**
+ * @brief Point the window at the file that was just saved - maps the saved
+ *        file, and updates the line index with the saved rows, so that every
+ *        loaded row counts as unchanged again. Should only be called when
+ *        no edits were made since the save snapshot was taken.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+void editorWindowRebase(eState *state);
+
+/**
+ * @brief Number of rows in the file - including the rows outside the
+ *        window in windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ * @return long long (total number of rows)
+ */
+long long editorTotalRows(eState *state);
+
+#endif
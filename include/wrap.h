@@ -0,0 +1,68 @@
+#ifndef WRAP_H
+#define WRAP_H
+
+#include "structs.h"
+
+/*** wrap layout ***/
+
+/**
+ * @brief Lays out the chars of a row into its render and wrap stops, in a
+ *        single pass over the row: tabs are rendered to spaces and soft wraps
+ *        are inserted (if set). The screen rows of the row are counted in the
+ *        row index along with it. A row without tabs that fits a screen row
+ *        (and has no gap in its chars) gets no render of its own, it is shown
+ *        from its chars.
+ *
+ * @param state (pointer to the editor state object)
+ * @param row (the row being laid out)
+ */
+void wrapLayoutRow(eState *state, erow *row);
+
+/**
+ * @brief Lays out a rendered row again after a single char was inserted or
+ *        deleted, from the word the edit is in on, up to the first wrap that
+ *        falls where it did before the edit. The rest of the old render and
+ *        wrap stops is reused. A row that was shown from its chars is laid out
+ *        again whole.
+ *
+ * @param state (pointer to the editor state object)
+ * @param row (the edited row, with its render from before the edit)
+ * @param at (index of the inserted char, or of the deleted char before the edit)
+ * @param delta (1 for an inserted char, -1 for a deleted one)
+ * @param removed (the deleted char)
+ */
+void wrapLayoutEdit(eState *state, erow *row, int at, int delta, char removed);
+
+/**
+ * @brief Counts a row whose render details were freed as a single screen
+ *        row again.
+ *
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ */
+void wrapClear(eState *state, erow *row);
+
+/**
+ * @brief The screen row a wrap of a row is shown on, counting the screen
+ *        rows from the first row in O(log n). Rows not rendered yet count
+ *        as a single screen row.
+ *
+ * @param state (pointer to the editor state object)
+ * @param filerow (row index, up to the number of rows)
+ * @param wrapoff (wrap of the row)
+ * @return long long (screen row)
+ */
+long long wrapScreenRow(eState *state, int filerow, int wrapoff);
+
+/**
+ * @brief The row and the wrap of it shown on a screen row, counting the
+ *        screen rows from the first row in O(log n).
+ *
+ * @param state (pointer to the editor state object)
+ * @param screenrow (screen row)
+ * @param wrapoff (set to the wrap of the row on the screen row)
+ * @return int (row index, the number of rows if @screenrow is past the last row)
+ */
+int wrapFileRow(eState *state, long long screenrow, int *wrapoff);
+
+#endif
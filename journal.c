@@ -0,0 +1,390 @@
+#include "syshead.h"
+
+#include "journal.h"
+#include "buffer.h"
+#include "consts.h"
+#include "file.h"
+#include "structs.h"
+#include "terminal.h"
+#include "window.h"
+
+/**
+ * @brief The start of a journal file - identifies the version of the file
+ *        the recorded edits apply to.
+ * 
+ * {
+ *      char magic[8]; (always "EDDIEJ2\n")
+ *      off_t size; (size of the file)
+ *      time_t mtime; (modification time of the file, seconds)
+ *      long mtime_nsec; (modification time of the file, nanoseconds)
+ * }
+ */
+struct journalHeader {
+    char magic[8];
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+};
+
+/**
+ * @brief A recorded edit, followed by the inserted characters in the file.
+ * 
+ * {
+ *      int op; (the edit - an enum journalOp)
+ *      long long line; (line number of the edited row in the file)
+ *      int pos; (column of the edit in the row)
+ *      int len; (number of inserted characters following the record)
+ * }
+ */
+struct journalRecord {
+    int op;
+    long long line;
+    int pos;
+    int len;
+};
+
+/**
+ * @brief The open journal of the file.
+ * 
+ * {
+ *      int fd; (the journal file, locked against other editors)
+ *      char *path; (path of the journal file)
+ *      struct abuf pending; (records not written yet)
+ *      off_t length; (length of the records written to the file)
+ *      time_t synced; (time the records were last written and synced)
+ * }
+ */
+struct journal {
+    int fd;
+    char *path;
+    struct abuf pending;
+    off_t length;
+    time_t synced;
+};
+
+/**
+ * @brief Path of the journal of a file - the file name with a dot in front
+ *        and a .journal extension, in the same directory.
+ * 
+ * @param filename (path of the file)
+ * @return char* (path of the journal, should be freed)
+ */
+static char *journal_path(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    int dirlen = slash ? slash - filename + 1 : 0;
+    size_t len = strlen(filename) + sizeof("..journal");
+    char *path = malloc(len);
+    snprintf(path, len, "%.*s.%s.journal", dirlen, filename, &filename[dirlen]);
+    return path;
+}
+
+/**
+ * @brief Fills in the journal header for the file as it is on disk now.
+ * 
+ * @param filename (path of the file)
+ * @param hdr (the header filled in)
+ * @return int (returns -1 if the file can't be accessed, otherwise 0)
+ */
+static int file_header(const char *filename, struct journalHeader *hdr) {
+    memset(hdr, 0, sizeof(*hdr)); // the padding is compared too
+    struct stat st;
+    if (stat(filename, &st) == -1)
+        return -1;
+    memcpy(hdr->magic, "EDDIEJ2\n", sizeof(hdr->magic));
+    hdr->size = st.st_size;
+    hdr->mtime = st.st_mtim.tv_sec;
+    hdr->mtime_nsec = st.st_mtim.tv_nsec;
+    return 0;
+}
+
+/**
+ * @brief Writes a whole buffer at an offset of a file, retrying short writes.
+ * 
+ * @param fd (descriptor of the file)
+ * @param buf (the written buffer)
+ * @param len (length of buf)
+ * @param offset (file offset to write at)
+ * @return int (returns -1 on failure, otherwise 0)
+ */
+static int write_at(int fd, const void *buf, size_t len, off_t offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t nwritten = pwrite(fd, p, len, offset);
+        if (nwritten == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += nwritten;
+        len -= nwritten;
+        offset += nwritten;
+    }
+    return 0;
+}
+
+/**
+ * @brief Creates a journal file atomically - it's written to a temporary
+ *        file that replaces the journal once synced.
+ * 
+ * @param path (path of the journal)
+ * @param hdr (the journal header)
+ * @param records (the records after the header)
+ * @param len (length of records)
+ * @return int (descriptor of the new journal, -1 on failure)
+ */
+static int create(const char *path, struct journalHeader *hdr, const char *records, size_t len) {
+    size_t tmplen = strlen(path) + sizeof(".XXXXXX");
+    char *tmp = malloc(tmplen);
+    snprintf(tmp, tmplen, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp); // readable by the owner only, like the edits it records should be
+    if (fd == -1) {
+        free(tmp);
+        return -1;
+    }
+    if (write_at(fd, hdr, sizeof(*hdr), 0) == -1 || write_at(fd, records, len, sizeof(*hdr)) == -1 ||
+        fsync(fd) == -1 || rename(tmp, path) == -1) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    flock(fd, LOCK_EX | LOCK_NB);
+    return fd;
+}
+
+/**
+ * @brief Applies a recorded edit to the rows - through the same row
+ *        operations that made it, loading the rows around it first in
+ *        windowed mode.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param rec (the recorded edit)
+ * @param s (the inserted characters)
+ * @return int (returns -1 if the edit doesn't fit the rows, otherwise 0)
+ */
+static int apply(eState *state, struct journalRecord *rec, char *s) {
+    editorWindowReach(state, rec->line);
+    long long at = rec->line - state->winfirst;
+    if (rec->op == JOURNAL_INSERT_ROW) {
+        if (at < 0 || at > state->numrows)
+            return -1;
+        editorInsertRow(state, at, s, rec->len);
+        return 0;
+    }
+    if (at < 0 || at >= state->numrows)
+        return -1;
+
+    erow *row = editorRow(state, at);
+    switch (rec->op) {
+    case JOURNAL_DEL_ROW:
+        editorDelRow(state, at);
+        break;
+    case JOURNAL_INSERT_CHAR:
+        if (rec->len != 1)
+            return -1;
+        editorRowInsertChar(state, row, rec->pos, (unsigned char)s[0]);
+        break;
+    case JOURNAL_DEL_CHAR:
+        editorRowDelChar(state, row, rec->pos);
+        break;
+    case JOURNAL_APPEND_STRING:
+        editorRowAppendString(state, row, s, rec->len);
+        break;
+    case JOURNAL_TRUNCATE:
+        editorRowTruncate(state, row, rec->pos);
+        break;
+    case JOURNAL_CRLF:
+        editorRowSetCrlf(state, row, rec->pos);
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Replays the records of a journal, up to the first one that is
+ *        incomplete (cut short by a crash) or doesn't fit the rows.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param buf (the records)
+ * @param len (length of buf)
+ * @param edits (set to the number of replayed edits)
+ * @return off_t (length of the replayed records)
+ */
+static off_t replay(eState *state, char *buf, size_t len, int *edits) {
+    size_t off = 0;
+    *edits = 0;
+    editorEditBegin(state); // a row edited many times is rendered once
+    while (off + sizeof(struct journalRecord) <= len) {
+        struct journalRecord rec;
+        memcpy(&rec, &buf[off], sizeof(rec));
+        char *s = &buf[off + sizeof(rec)];
+        if (rec.len < 0 || (size_t)rec.len > len - off - sizeof(rec))
+            break;
+        if (apply(state, &rec, s) == -1)
+            break;
+        off += sizeof(rec) + rec.len;
+        (*edits)++;
+    }
+    editorEditCommit(state);
+    return off;
+}
+
+/**
+ * @brief Replays the edits of a journal left behind, if it was written for
+ *        the file as it is on disk now. A record cut short by a crash is
+ *        dropped from the journal.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param fd (descriptor of the journal)
+ * @param hdr (the header of the file as it is on disk now)
+ * @param length (set to the length of the replayed records)
+ * @param edits (set to the number of replayed edits)
+ * @return int (returns -1 if the journal doesn't fit the file, 1 if it holds no edits, otherwise 0)
+ */
+static int recover(eState *state, int fd, struct journalHeader *hdr, off_t *length, int *edits) {
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -1;
+    if (st.st_size <= (off_t)sizeof(*hdr))
+        return 1;
+
+    char *buf = malloc(st.st_size);
+    ssize_t size = pread(fd, buf, st.st_size, 0);
+    if (size < (ssize_t)sizeof(*hdr) || memcmp(buf, hdr, sizeof(*hdr)) != 0) {
+        free(buf);
+        return -1;
+    }
+    editorLoadWait(state); // the edits apply to the rows of the whole file
+    *length = replay(state, &buf[sizeof(*hdr)], size - sizeof(*hdr), edits);
+    free(buf);
+    if (ftruncate(fd, sizeof(*hdr) + *length) == -1)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Stops journaling after a failure - the journal is deleted, as it
+ *        no longer holds all the edits.
+ * 
+ * @param state (pointer to the editor state object)
+ */
+static void give_up(eState *state) {
+    editorSetStatusMessage(state, "Journal I/O error: %s - edits are no longer journaled", strerror(errno));
+    editorJournalClose(state);
+}
+
+void editorJournalOpen(eState *state) {
+    struct journalHeader hdr;
+    if (state->filename == NULL || file_header(state->filename, &hdr) == -1)
+        return;
+
+    char *path = journal_path(state->filename);
+    int fd = open(path, O_RDWR);
+    int edits = 0;
+    off_t length = 0;
+    if (fd != -1) {
+        int found = (flock(fd, LOCK_EX | LOCK_NB) == 0) ? recover(state, fd, &hdr, &length, &edits) : -1;
+        if (found == -1) { // left for the user to check - another editor has it, or the file changed since
+            editorSetStatusMessage(state, "Found %.40s of another session - edits are not journaled", path);
+            free(path);
+            close(fd);
+            return;
+        }
+        if (found == 1) { // nothing to recover, start over
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd == -1) {
+        fd = create(path, &hdr, NULL, 0);
+        if (fd == -1) {
+            free(path);
+            return;
+        }
+    }
+
+    struct journal *journal = malloc(sizeof(struct journal));
+    journal->fd = fd;
+    journal->path = path;
+    journal->pending = (struct abuf)ABUF_INIT;
+    journal->length = length;
+    journal->synced = time(NULL);
+    state->journal = journal;
+    if (edits > 0)
+        editorSetStatusMessage(state, "Recovered %d edits from %.40s", edits, path);
+}
+
+void editorJournalRecord(eState *state, enum journalOp op, int at, int pos, const char *s, int len) {
+    struct journal *journal = state->journal;
+    if (journal == NULL)
+        return;
+
+    struct journalRecord rec = {op, state->winfirst + at, pos, len};
+    abAppend(&journal->pending, (const char *)&rec, sizeof(rec));
+    if (len > 0)
+        abAppend(&journal->pending, s, len);
+    if (journal->pending.len >= EDDIE_JOURNAL_BATCH || time(NULL) - journal->synced >= EDDIE_JOURNAL_INTERVAL)
+        editorJournalCommit(state);
+}
+
+void editorJournalCommit(eState *state) {
+    struct journal *journal = state->journal;
+    if (journal == NULL || journal->pending.len == 0)
+        return;
+
+    off_t offset = sizeof(struct journalHeader) + journal->length;
+    if (write_at(journal->fd, journal->pending.b, journal->pending.len, offset) == -1 ||
+        fdatasync(journal->fd) == -1) {
+        give_up(state);
+        return;
+    }
+    journal->length += journal->pending.len;
+    journal->pending.len = 0; // the buffer is reused for the next batch
+    journal->synced = time(NULL);
+}
+
+off_t editorJournalMark(eState *state) {
+    if (state->journal == NULL)
+        return 0;
+    return state->journal->length + state->journal->pending.len;
+}
+
+void editorJournalRebase(eState *state, off_t mark) {
+    struct journal *journal = state->journal;
+    if (journal == NULL)
+        return;
+    editorJournalCommit(state);
+    if (state->journal == NULL)
+        return;
+
+    struct journalHeader hdr;
+    size_t keep = journal->length - mark;
+    char *buf = malloc(keep);
+    int fd = -1;
+    if (file_header(state->filename, &hdr) == 0 &&
+        pread(journal->fd, buf, keep, sizeof(hdr) + mark) == (ssize_t)keep)
+        fd = create(journal->path, &hdr, buf, keep);
+    free(buf);
+    if (fd == -1) { // the old journal doesn't fit the file anymore
+        give_up(state);
+        return;
+    }
+    close(journal->fd);
+    journal->fd = fd;
+    journal->length = keep;
+}
+
+void editorJournalClose(eState *state) {
+    struct journal *journal = state->journal;
+    if (journal == NULL)
+        return;
+    unlink(journal->path);
+    close(journal->fd);
+    abFree(&journal->pending);
+    free(journal->path);
+    free(journal);
+    state->journal = NULL;
+}
@@ -0,0 +1,463 @@
+#include "syshead.h"
+
+#include "lineidx.h"
+#include "consts.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define LINEIDX_X86 // SSE2 is always available on x86-64, AVX2 is checked at runtime
+#endif /* __x86_64__ */
+
+/**
+ * @brief A slice of the buffer, indexed by one thread of a parallel build.
+ * 
+ * {
+ *      pthread_t thread; (the thread indexing the slice)
+ *      int running; (whether the thread was started)
+ *      const char *buf; (the buffer being indexed)
+ *      size_t from, to; (the slice is buf[from, to))
+ *      size_t count; (number of newlines in the slice)
+ *      size_t first; (number of newlines before the slice)
+ *      struct lineidx view; (the part of the offsets array the slice fills)
+ * }
+ */
+struct slice {
+    pthread_t thread;
+    int running;
+    const char *buf;
+    size_t from, to;
+    size_t count;
+    size_t first;
+    struct lineidx view;
+};
+
+/**
+ * @brief Grow the offsets array to hold at least @cap offsets - on the heap,
+ *        or by extending and remapping its backing file. A backing file
+ *        that can't be extended is given up for the heap.
+ * 
+ * @param idx (the line index)
+ * @param cap (number of offsets to make room for)
+ */
+static void reserve(struct lineidx *idx, long long cap) {
+    if (idx->fd != -1) {
+        size_t *off = MAP_FAILED;
+        if (ftruncate(idx->fd, sizeof(size_t) * cap) == 0)
+            off = mmap(NULL, sizeof(size_t) * cap, PROT_READ | PROT_WRITE, MAP_SHARED, idx->fd, 0);
+        if (off == MAP_FAILED) { // out of disk space - move the offsets to the heap
+            off = malloc(sizeof(size_t) * cap);
+            if (idx->off)
+                memcpy(off, idx->off, sizeof(size_t) * idx->cap);
+            close(idx->fd);
+            idx->fd = -1;
+        }
+        if (idx->off)
+            munmap(idx->off, sizeof(size_t) * idx->cap);
+        idx->off = off;
+    } else {
+        idx->off = realloc(idx->off, sizeof(size_t) * cap);
+    }
+    idx->cap = cap;
+}
+
+/**
+ * @brief Append a line end offset to the index, growing the offsets
+ *        array geometrically.
+ * 
+ * @param idx (the line index)
+ * @param off (offset right after a newline)
+ */
+static void add_offset(struct lineidx *idx, size_t off) {
+    if (idx->count + 1 >= idx->cap)
+        reserve(idx, idx->cap ? idx->cap * 2 : 1024);
+    idx->off[++idx->count] = off;
+}
+
+/**
+ * @brief Portable newline scan of buf[from, to).
+ * 
+ * @param idx (the line index)
+ * @param buf (the buffer being indexed)
+ * @param from (scan start offset)
+ * @param to (scan end offset)
+ */
+static void scan_fallback(struct lineidx *idx, const char *buf, size_t from, size_t to) {
+    const char *p = buf + from;
+    const char *end = buf + to;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        add_offset(idx, p - buf + 1);
+        p++;
+    }
+}
+
+#ifdef LINEIDX_X86
+/**
+ * @brief SSE2 newline scan of buf[from, to), 16 bytes at a time.
+ * 
+ * @param idx (the line index)
+ * @param buf (the buffer being indexed)
+ * @param from (scan start offset)
+ * @param to (scan end offset)
+ */
+static void scan_sse2(struct lineidx *idx, const char *buf, size_t from, size_t to) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i;
+    for (i = from; i + 16 <= to; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(buf + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while (mask) { // one set bit per newline in the chunk
+            add_offset(idx, i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+    scan_fallback(idx, buf, i, to);
+}
+
+/**
+ * @brief AVX2 newline scan of buf[from, to), 32 bytes at a time.
+ * 
+ * @param idx (the line index)
+ * @param buf (the buffer being indexed)
+ * @param from (scan start offset)
+ * @param to (scan end offset)
+ */
+__attribute__((target("avx2")))
+static void scan_avx2(struct lineidx *idx, const char *buf, size_t from, size_t to) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i;
+    for (i = from; i + 32 <= to; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(buf + i));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        while (mask) {
+            add_offset(idx, i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+    scan_sse2(idx, buf, i, to);
+}
+#endif /* LINEIDX_X86 */
+
+/**
+ * @brief Portable newline count of buf[from, to).
+ * 
+ * @param buf (the buffer being counted)
+ * @param from (count start offset)
+ * @param to (count end offset)
+ * @return size_t (number of newlines)
+ */
+static size_t count_fallback(const char *buf, size_t from, size_t to) {
+    const char *p = buf + from;
+    const char *end = buf + to;
+    size_t count = 0;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        count++;
+        p++;
+    }
+    return count;
+}
+
+#ifdef LINEIDX_X86
+/**
+ * @brief SSE2 newline count of buf[from, to), 16 bytes at a time.
+ * 
+ * @param buf (the buffer being counted)
+ * @param from (count start offset)
+ * @param to (count end offset)
+ * @return size_t (number of newlines)
+ */
+static size_t count_sse2(const char *buf, size_t from, size_t to) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    size_t i;
+    for (i = from; i + 16 <= to; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(buf + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+    }
+    return count + count_fallback(buf, i, to);
+}
+
+/**
+ * @brief AVX2 newline count of buf[from, to), 32 bytes at a time.
+ * 
+ * @param buf (the buffer being counted)
+ * @param from (count start offset)
+ * @param to (count end offset)
+ * @return size_t (number of newlines)
+ */
+__attribute__((target("avx2")))
+static size_t count_avx2(const char *buf, size_t from, size_t to) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i;
+    for (i = from; i + 32 <= to; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(buf + i));
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+    }
+    return count + count_sse2(buf, i, to);
+}
+#endif /* LINEIDX_X86 */
+
+/**
+ * @brief Index the newlines of buf[from, to) with the fastest scan the cpu has.
+ * 
+ * @param idx (the line index)
+ * @param buf (the buffer being indexed)
+ * @param from (scan start offset)
+ * @param to (scan end offset)
+ */
+static void scan(struct lineidx *idx, const char *buf, size_t from, size_t to) {
+#ifdef LINEIDX_X86
+    if (__builtin_cpu_supports("avx2"))
+        scan_avx2(idx, buf, from, to);
+    else
+        scan_sse2(idx, buf, from, to);
+#else
+    scan_fallback(idx, buf, from, to);
+#endif /* LINEIDX_X86 */
+}
+
+/**
+ * @brief Count the newlines of buf[from, to) with the fastest scan the cpu has.
+ * 
+ * @param buf (the buffer being counted)
+ * @param from (count start offset)
+ * @param to (count end offset)
+ * @return size_t (number of newlines)
+ */
+static size_t count(const char *buf, size_t from, size_t to) {
+#ifdef LINEIDX_X86
+    if (__builtin_cpu_supports("avx2"))
+        return count_avx2(buf, from, to);
+    return count_sse2(buf, from, to);
+#else
+    return count_fallback(buf, from, to);
+#endif /* LINEIDX_X86 */
+}
+
+/**
+ * @brief Thread routine counting the newlines of a slice.
+ * 
+ * @param arg (the slice)
+ * @return void* (unused)
+ */
+static void *count_slice(void *arg) {
+    struct slice *slice = arg;
+    slice->count = count(slice->buf, slice->from, slice->to);
+    return NULL;
+}
+
+/**
+ * @brief Thread routine writing the line offsets of a slice into its view.
+ * 
+ * @param arg (the slice)
+ * @return void* (unused)
+ */
+static void *scan_slice(void *arg) {
+    struct slice *slice = arg;
+    scan(&slice->view, slice->buf, slice->from, slice->to);
+    return NULL;
+}
+
+/**
+ * @brief Runs a routine over all slices in parallel - a thread for each
+ *        slice but the first, which the calling thread takes. A slice whose
+ *        thread can't be started is run by the calling thread as well.
+ * 
+ * @param slices (the slices)
+ * @param n (number of slices)
+ * @param routine (the routine run for each slice)
+ */
+static void run_slices(struct slice *slices, int n, void *(*routine)(void *)) {
+    for (int j = 1; j < n; j++)
+        slices[j].running = (pthread_create(&slices[j].thread, NULL, routine, &slices[j]) == 0);
+    routine(&slices[0]);
+    for (int j = 1; j < n; j++) {
+        if (slices[j].running)
+            pthread_join(slices[j].thread, NULL);
+        else
+            routine(&slices[j]);
+    }
+}
+
+/**
+ * @brief Number of threads to index a buffer with - one per cpu, as long as
+ *        each gets at least EDDIE_INDEX_SLICE bytes.
+ * 
+ * @param size (size of the buffer)
+ * @return int (number of threads)
+ */
+static int index_threads(size_t size) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t slices = size / EDDIE_INDEX_SLICE;
+    int n = (cpus > 0) ? cpus : 1;
+    if ((size_t)n > slices)
+        n = slices;
+    if (n > EDDIE_INDEX_THREADS)
+        n = EDDIE_INDEX_THREADS;
+    return (n > 0) ? n : 1;
+}
+
+/**
+ * @brief Index the newlines of buf[from, size) in two parallel passes over
+ *        slices of it: the newlines of each slice are counted first, and a
+ *        prefix sum of the counts gives the line number each slice starts at.
+ *        The offsets array is then sized exactly once, and each slice writes
+ *        its offsets straight into its own part of it.
+ * 
+ * @param idx (the line index, holding the lines before from)
+ * @param buf (the buffer being indexed)
+ * @param from (scan start offset)
+ * @param size (size of the buffer)
+ * @param n (number of slices)
+ */
+static void scan_parallel(struct lineidx *idx, const char *buf, size_t from, size_t size, int n) {
+    struct slice *slices = calloc(n, sizeof(struct slice));
+    size_t step = (size - from) / n;
+    for (int j = 0; j < n; j++) {
+        slices[j].buf = buf;
+        slices[j].from = from + step * j;
+        slices[j].to = (j == n - 1) ? size : from + step * (j + 1);
+    }
+    run_slices(slices, n, count_slice);
+
+    size_t total = idx->count;
+    for (int j = 0; j < n; j++) {
+        slices[j].first = total;
+        total += slices[j].count;
+    }
+    if (total + 2 > (size_t)idx->cap) // room for an unterminated last line too
+        reserve(idx, total + 2);
+
+    for (int j = 0; j < n; j++) {
+        // a view with exactly the room for the slice, so add_offset never grows it
+        struct lineidx *view = &slices[j].view;
+        view->off = &idx->off[slices[j].first];
+        view->count = 0;
+        view->cap = slices[j].count + 2;
+        view->fd = -1;
+    }
+    run_slices(slices, n, scan_slice);
+    idx->count = total;
+    free(slices);
+}
+
+void lineIndexBuild(struct lineidx *idx, const char *buf, size_t size) {
+    idx->count = -1;
+    add_offset(idx, 0); // first line always starts at the beginning
+
+    int threads = index_threads(size);
+    if (threads > 1)
+        scan_parallel(idx, buf, 0, size, threads);
+    else
+        scan(idx, buf, 0, size);
+
+    if (size > 0 && buf[size - 1] != '\n')
+        add_offset(idx, size + 1); // last line has no newline
+}
+
+void lineIndexExtend(struct lineidx *idx, const char *buf, size_t from, size_t size) {
+    if (idx->count > 0 && idx->off[idx->count] > from)
+        idx->count--; // the last line had no newline, the appended bytes continue it
+
+    int threads = index_threads(size - from);
+    if (threads > 1)
+        scan_parallel(idx, buf, from, size, threads);
+    else
+        scan(idx, buf, from, size);
+
+    if (size > 0 && buf[size - 1] != '\n')
+        add_offset(idx, size + 1);
+}
+
+void lineIndexAppend(struct lineidx *idx, struct lineidx *src, size_t base) {
+    if (idx->count == 0) {
+        idx->count = -1;
+        add_offset(idx, base + src->off[0]);
+    }
+    for (long long j = 1; j <= src->count; j++)
+        add_offset(idx, base + src->off[j]);
+}
+
+size_t lineIndexLen(struct lineidx *idx, long long at) {
+    return idx->off[at + 1] - idx->off[at] - 1;
+}
+
+long long lineIndexFind(struct lineidx *idx, size_t off) {
+    long long lo = 0, hi = idx->count - 1;
+    while (lo < hi) { // last line starting at or before off
+        long long mid = lo + (hi - lo + 1) / 2;
+        if (idx->off[mid] <= off)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+void lineIndexSplice(struct lineidx *idx, long long first, long long last, const size_t *lens, int count) {
+    long long newcount = idx->count + count - (last - first);
+    if (newcount + 1 > idx->cap)
+        reserve(idx, newcount + 1);
+
+    size_t start = idx->off[first];
+    size_t end = start;
+    for (int j = 0; j < count; j++)
+        end += lens[j];
+    size_t delta = end - idx->off[last]; // wraps around when the lines got shorter, which cancels out below
+
+    memmove(&idx->off[first + count], &idx->off[last], sizeof(size_t) * (idx->count - last + 1));
+    idx->off[first] = start;
+    for (int j = 0; j < count; j++)
+        idx->off[first + j + 1] = idx->off[first + j] + lens[j];
+    for (long long j = first + count + 1; j <= newcount; j++)
+        idx->off[j] += delta;
+    idx->count = newcount;
+}
+
+int lineIndexRead(struct lineidx *idx, int fd, off_t offset, long long count) {
+    if (count + 2 > idx->cap)
+        reserve(idx, count + 2);
+    char *p = (char *)idx->off;
+    size_t len = sizeof(size_t) * (count + 1);
+    while (len > 0) {
+        ssize_t nread = pread(fd, p, len, offset);
+        if (nread == -1 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return -1;
+        p += nread;
+        len -= nread;
+        offset += nread;
+    }
+    idx->count = count;
+    return 0;
+}
+
+int lineIndexWrite(struct lineidx *idx, int fd, off_t offset) {
+    const char *p = (const char *)idx->off;
+    size_t len = sizeof(size_t) * (idx->count + 1);
+    while (len > 0) {
+        ssize_t nwritten = pwrite(fd, p, len, offset);
+        if (nwritten == -1 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+            return -1;
+        p += nwritten;
+        len -= nwritten;
+        offset += nwritten;
+    }
+    return 0;
+}
+
+void lineIndexFree(struct lineidx *idx) {
+    if (idx->fd != -1) {
+        munmap(idx->off, sizeof(size_t) * idx->cap);
+        close(idx->fd);
+        idx->fd = -1;
+    } else {
+        free(idx->off);
+    }
+    idx->off = NULL;
+    idx->count = 0;
+    idx->cap = 0;
+}
@@ -0,0 +1,313 @@
+#include "syshead.h"
+
+#include "rowidx.h"
+#include "consts.h"
+#include "structs.h"
+#include "terminal.h"
+
+/**
+ * @brief Copies @n rows with their fields from @src at @from to @dst at
+ *        @to. The ranges may overlap.
+ *
+ * @param dst (the chunk copied to)
+ * @param to (index of the first row in @dst)
+ * @param src (the chunk copied from)
+ * @param from (index of the first row in @src)
+ * @param n (number of rows)
+ */
+static void move_rows(struct rowChunk *dst, int to, struct rowChunk *src, int from, int n) {
+    memmove(&dst->rows[to], &src->rows[from], sizeof(erow) * n);
+    memmove(&dst->size[to], &src->size[from], sizeof(int) * n);
+    memmove(&dst->wraps[to], &src->wraps[from], sizeof(int) * n);
+    memmove(&dst->open_comment[to], &src->open_comment[from], n);
+    memmove(&dst->flags[to], &src->flags[from], n);
+}
+
+/**
+ * @brief Recalculates the Fenwick tree entries of the chunks from @from on,
+ *        after chunks were added or removed there. Entries before it only
+ *        cover the chunks before it, which didn't change. This is the
+ *        O(n / EDDIE_ROW_CHUNK) part of a split or removal, amortized over
+ *        the row edits that lead to it (see struct rowidx).
+ *
+ * @param idx (the row index)
+ * @param from (first changed chunk)
+ */
+static void build_tree(struct rowidx *idx, int from) {
+    for (int i = from + 1; i <= idx->nchunks; i++) {
+        idx->tree[i] = idx->chunks[i - 1]->count;
+        idx->lines[i] = idx->chunks[i - 1]->lines;
+        for (int step = 1; step < (i & -i); step <<= 1) { // the entries the one of i is the sum of
+            idx->tree[i] += idx->tree[i - step];
+            idx->lines[i] += idx->lines[i - step];
+        }
+    }
+}
+
+/**
+ * @brief Adds @delta rows to the size of chunk @slot in the Fenwick tree.
+ *
+ * @param idx (the row index)
+ * @param slot (the chunk)
+ * @param delta (number of rows added, negative if removed)
+ */
+static void tree_add(struct rowidx *idx, int slot, int delta) {
+    for (int i = slot + 1; i <= idx->nchunks; i += i & -i)
+        idx->tree[i] += delta;
+}
+
+/**
+ * @brief Adds @delta screen rows to chunk @slot in the Fenwick tree of
+ *        screen rows.
+ *
+ * @param idx (the row index)
+ * @param slot (the chunk)
+ * @param delta (number of screen rows added, negative if removed)
+ */
+static void lines_add(struct rowidx *idx, int slot, int delta) {
+    for (int i = slot + 1; i <= idx->nchunks; i += i & -i)
+        idx->lines[i] += delta;
+}
+
+/**
+ * @brief Number of screen rows rows [from, to) of a chunk take.
+ *
+ * @param chunk (the chunk)
+ * @param from (first row)
+ * @param to (row after the last one)
+ * @return int (number of screen rows)
+ */
+static int chunk_lines(struct rowChunk *chunk, int from, int to) {
+    int lines = 0;
+    for (int j = from; j < to; j++)
+        lines += chunk->wraps[j] + 1;
+    return lines;
+}
+
+/**
+ * @brief Finds the chunk of row @at, by walking down the Fenwick tree.
+ *
+ * @param idx (the row index)
+ * @param at (row number)
+ * @param first (set to the number of the first row in the chunk)
+ * @return int (the chunk, nchunks if @at is past the last row)
+ */
+static int find_chunk(struct rowidx *idx, int at, int *first) {
+    if (idx->last && at >= idx->lastfirst && at < idx->lastfirst + idx->last->count) {
+        *first = idx->lastfirst;
+        return idx->last->slot;
+    }
+
+    int slot = 0;
+    int rest = at;
+    int step = 1;
+    while (step * 2 <= idx->nchunks)
+        step *= 2;
+    for (; step > 0; step >>= 1) {
+        if (slot + step <= idx->nchunks && idx->tree[slot + step] <= rest) {
+            slot += step; // all rows of the chunks up to slot + step come before @at
+            rest -= idx->tree[slot];
+        }
+    }
+    *first = at - rest;
+    return slot;
+}
+
+/**
+ * @brief Adds @n empty chunks at position @slot. The Fenwick tree is left
+ *        for the caller to build once the chunks are filled.
+ *
+ * @param idx (the row index)
+ * @param slot (position of the first new chunk)
+ * @param n (number of chunks)
+ */
+static void add_chunks(struct rowidx *idx, int slot, int n) {
+    if (idx->nchunks + n > idx->cap) {
+        idx->cap = (idx->nchunks + n) * 2;
+        idx->chunks = realloc(idx->chunks, sizeof(struct rowChunk *) * idx->cap);
+        idx->tree = realloc(idx->tree, sizeof(int) * (idx->cap + 1));
+        idx->lines = realloc(idx->lines, sizeof(long long) * (idx->cap + 1));
+    }
+    memmove(&idx->chunks[slot + n], &idx->chunks[slot], sizeof(struct rowChunk *) * (idx->nchunks - slot));
+    for (int k = slot; k < slot + n; k++) {
+        void *chunk;
+        if (posix_memalign(&chunk, EDDIE_ROW_CHUNK, sizeof(struct rowChunk)) != 0)
+            die("posix_memalign");
+        idx->chunks[k] = chunk;
+        idx->chunks[k]->count = 0;
+        idx->chunks[k]->lines = 0;
+    }
+    idx->nchunks += n;
+    for (int k = slot; k < idx->nchunks; k++)
+        idx->chunks[k]->slot = k;
+}
+
+erow *rowIndexGet(struct rowidx *idx, int at) {
+    int first;
+    int slot = find_chunk(idx, at, &first);
+    idx->last = idx->chunks[slot];
+    idx->lastfirst = first;
+    return &idx->last->rows[at - first];
+}
+
+int rowIndexOf(struct rowidx *idx, erow *row) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    if (chunk == idx->last)
+        return idx->lastfirst + (row - chunk->rows);
+
+    int first = 0;
+    for (int i = chunk->slot; i > 0; i -= i & -i)
+        first += idx->tree[i];
+    return first + (row - chunk->rows);
+}
+
+void rowIndexInsert(struct rowidx *idx, int at, int count) {
+    if (count <= 0)
+        return;
+    if (idx->nchunks == 0) {
+        add_chunks(idx, 0, 1);
+        build_tree(idx, 0);
+    }
+    int first;
+    int slot = find_chunk(idx, at, &first);
+    if (slot == idx->nchunks) { // appended after the last row
+        slot--;
+        first -= idx->chunks[slot]->count;
+    }
+    struct rowChunk *chunk = idx->chunks[slot];
+    int off = at - first;
+    idx->count += count;
+    idx->last = NULL;
+
+    if (chunk->count + count <= (int)ROW_CHUNK_ROWS) {
+        move_rows(chunk, off + count, chunk, off, chunk->count - off);
+        memset(&chunk->wraps[off], 0, sizeof(int) * count);
+        chunk->count += count;
+        chunk->lines += count;
+        tree_add(idx, slot, count);
+        lines_add(idx, slot, count);
+        return;
+    }
+
+    // the rows of the chunk and the new slots are laid out over as many chunks as they need
+    int oldcount = chunk->count;
+    int total = oldcount + count;
+    int parts = (total + ROW_CHUNK_ROWS - 1) / ROW_CHUNK_ROWS;
+    struct rowChunk *old = malloc(sizeof(struct rowChunk));
+    move_rows(old, 0, chunk, 0, oldcount);
+    add_chunks(idx, slot + 1, parts - 1);
+    int pos = 0; // position in the rows of the chunk, with the new slots in place
+    for (int k = 0; k < parts; k++) {
+        struct rowChunk *part = idx->chunks[slot + k];
+        int size = total / parts + (k < total % parts);
+        if (off == oldcount) // appending fills the chunks, they are not going to get inserts
+            size = (total - pos < (int)ROW_CHUNK_ROWS) ? total - pos : (int)ROW_CHUNK_ROWS;
+        int end = pos + size;
+        int head = ((off < end) ? off : end) - pos; // old rows before the new slots in the part
+        if (head > 0)
+            move_rows(part, 0, old, pos, head);
+        int tail = (off + count > pos) ? off + count : pos; // first row after the new slots in the part
+        if (tail < end)
+            move_rows(part, tail - pos, old, tail - count, end - tail);
+        for (int j = (head > 0 ? head : 0); j < tail - pos && j < size; j++)
+            part->wraps[j] = 0; // a new slot
+        part->count = size;
+        part->lines = chunk_lines(part, 0, size);
+        pos = end;
+    }
+    free(old);
+    build_tree(idx, slot);
+}
+
+void rowIndexRemove(struct rowidx *idx, int at, int count) {
+    if (count <= 0)
+        return;
+    int first;
+    int slot = find_chunk(idx, at, &first);
+    int off = at - first;
+    int from = slot;
+    int emptied = 0;
+    idx->count -= count;
+    idx->last = NULL;
+
+    while (count > 0) {
+        struct rowChunk *chunk = idx->chunks[slot];
+        int n = (count < chunk->count - off) ? count : chunk->count - off;
+        int lines = chunk_lines(chunk, off, off + n);
+        chunk->lines -= lines;
+        move_rows(chunk, off, chunk, off + n, chunk->count - off - n);
+        chunk->count -= n;
+        count -= n;
+        if (chunk->count == 0)
+            emptied++;
+        else {
+            tree_add(idx, slot, -n);
+            lines_add(idx, slot, -lines);
+        }
+        slot++;
+        off = 0;
+    }
+    if (emptied == 0)
+        return;
+
+    int kept = from;
+    for (int j = from; j < idx->nchunks; j++) {
+        if (idx->chunks[j]->count == 0) {
+            free(idx->chunks[j]);
+            continue;
+        }
+        idx->chunks[kept] = idx->chunks[j];
+        idx->chunks[kept]->slot = kept;
+        kept++;
+    }
+    idx->nchunks = kept;
+    build_tree(idx, from);
+}
+
+void rowIndexAddLines(struct rowidx *idx, erow *row, int delta) {
+    struct rowChunk *chunk = rowChunkOf(row);
+    chunk->lines += delta;
+    lines_add(idx, chunk->slot, delta);
+}
+
+long long rowIndexLine(struct rowidx *idx, int at) {
+    int first;
+    int slot = find_chunk(idx, at, &first);
+    long long line = 0;
+    for (int i = slot; i > 0; i -= i & -i)
+        line += idx->lines[i];
+    if (slot < idx->nchunks)
+        line += chunk_lines(idx->chunks[slot], 0, at - first);
+    return line;
+}
+
+int rowIndexAtLine(struct rowidx *idx, long long line, int *wrap) {
+    *wrap = 0;
+    if (line < 0)
+        return 0;
+
+    int slot = 0;
+    int first = 0;
+    long long rest = line;
+    int step = 1;
+    while (step * 2 <= idx->nchunks)
+        step *= 2;
+    for (; step > 0; step >>= 1) {
+        if (slot + step <= idx->nchunks && idx->lines[slot + step] <= rest) {
+            slot += step; // all screen rows of the chunks up to slot + step come before @line
+            rest -= idx->lines[slot];
+            first += idx->tree[slot];
+        }
+    }
+    if (slot == idx->nchunks)
+        return idx->count;
+
+    struct rowChunk *chunk = idx->chunks[slot];
+    int j = 0;
+    while (j < chunk->count - 1 && rest > chunk->wraps[j]) {
+        rest -= chunk->wraps[j] + 1;
+        j++;
+    }
+    *wrap = rest;
+    return first + j;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Opens a file of many short rows in eddie, in a pseudo terminal, and
+# reports how long it took to load and the resident memory of the editor
+# once it did - the memory the rows of a large file take.
+#
+# usage: scripts/bench-rows.sh [path to eddie] [rows] (default ./out/eddie, 10000000)
+
+EDDIE=${1:-./out/eddie}
+ROWS=${2:-10000000}
+WAIT=120 # most seconds to wait for the file to load
+
+dir=$(mktemp -d)
+trap 'kill $spid 2>/dev/null; rm -rf "$dir"' EXIT
+
+# short lines of code like words, some empty - the same file on every run
+file="$dir/rows.c"
+awk -v rows="$ROWS" 'BEGIN {
+    srand(1)
+    split("return|a|b+1;|x|if|=|{|int|// note|foo(bar);|\tcall();", words, "|")
+    for (i = 0; i < rows; i++) {
+        n = int(rand() * 4)
+        line = ""
+        for (k = 0; k < n; k++)
+            line = line (k ? " " : "") words[int(rand() * 11) + 1]
+        print line
+    }
+}' >"$file"
+
+mkfifo "$dir/keys"
+start=$(date +%s.%N)
+XDG_CACHE_HOME="$dir" script -qfc "stty rows 24 cols 80; exec '$EDDIE' '$file'" /dev/null \
+    <"$dir/keys" >"$dir/screen" 2>&1 &
+spid=$!
+exec 3>"$dir/keys"
+
+i=0
+while ! grep -q -- " - $ROWS lines  " "$dir/screen"; do
+    i=$((i + 1))
+    if [ $i -gt $((WAIT * 10)) ] || ! kill -0 $spid 2>/dev/null; then
+        echo "FAIL: $file was not loaded"
+        exit 1
+    fi
+    sleep 0.1
+done
+end=$(date +%s.%N)
+
+sleep 1 # let the first screens settle
+pid=$(pgrep -P $spid)
+rss=$(awk '/^VmRSS/ { print $2 }' "/proc/$pid/status")
+size=$(wc -c <"$file")
+awk -v rows="$ROWS" -v size="$size" -v start="$start" -v end="$end" -v rss="$rss" 'BEGIN {
+    printf "%d rows (%.1f MB): loaded in %.2fs, resident %.0f MB\n", rows, size / 1e6, end - start, rss / 1024
+}'
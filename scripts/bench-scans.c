@@ -0,0 +1,63 @@
+#include "syshead.h"
+
+#include "buffer.h"
+#include "file.h"
+#include "search.h"
+#include "structs.h"
+#include "wrap.h"
+
+/*
+ * Times the scans over every row of a file that read the row fields, once
+ * the file is loaded: the screen rows of the rows (as recalcIy and
+ * editorScroll count them), the length of the rows in the saved file (as a
+ * save or the window rebase sums them), and a search for text that is not
+ * in the file (editorFindCallback going over all the rows).
+ * Built along with the sources of eddie by scripts/bench-scans.sh, with the
+ * main of eddie renamed. Needs a terminal, for the screen size.
+ *
+ * usage: bench-scans <file> <results file>
+ */
+
+eState *initEditor();
+
+/**
+ * @brief The time on a monotonic clock.
+ *
+ * @return double (seconds)
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3)
+        return 2;
+    eState *state = initEditor();
+    editorOpen(state, argv[1]);
+    editorLoadWait(state);
+
+    double start = now();
+    long long lines = 0;
+    for (int j = 0; j < state->numrows; j += 16) // each lookup scans a chunk, a sample of the rows is enough
+        lines += wrapScreenRow(state, j, 0);
+    double screen = now() - start;
+
+    start = now();
+    size_t len = 0;
+    for (int j = 0; j < state->numrows; j++)
+        len += editorRowFileLen(state, editorRow(state, j));
+    double save = now() - start;
+
+    start = now();
+    editorFindCallback(state, "no such text", 'x');
+    double find = now() - start;
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL)
+        return 1;
+    fprintf(out, "%d %.3f %.3f %.3f %lld %zu\n", state->numrows, screen, save, find, lines, len); // the sums keep the scans in
+    fclose(out);
+    return 0;
+}
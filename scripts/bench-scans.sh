@@ -0,0 +1,51 @@
+#!/bin/sh
+# Times the scans over every row of a file of many short rows (see
+# bench-scans.c) for the sources in the working tree and for an earlier
+# revision of them, both built with -O2 and with the flags of the Makefile.
+#
+# usage: scripts/bench-scans.sh <revision> [rows] (from the top of the repository, default 10000000 rows)
+
+REV=${1:?usage: scripts/bench-scans.sh <revision> [rows]}
+ROWS=${2:-10000000}
+RUNS=3 # runs of each build, the fastest time of each scan is reported
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# the same file as scripts/bench-rows.sh
+file="$dir/rows.c"
+awk -v rows="$ROWS" 'BEGIN {
+    srand(1)
+    split("return|a|b+1;|x|if|=|{|int|// note|foo(bar);|\tcall();", words, "|")
+    for (i = 0; i < rows; i++) {
+        n = int(rand() * 4)
+        line = ""
+        for (k = 0; k < n; k++)
+            line = line (k ? " " : "") words[int(rand() * 11) + 1]
+        print line
+    }
+}' >"$file"
+
+# build <source tree> <binary> - eddie.c is built with its main renamed, the driver has its own
+build() {
+    files=$(sed -n 's/^C_FILES = //p' "$1/Makefile" | sed 's/eddie\.c//')
+    (cd "$1" && ${CC:-cc} -O2 -std=c99 -w -I./include -Dmain=eddie_main -c eddie.c -o "$2.o" &&
+        ${CC:-cc} -O2 -std=c99 -w -I./include $files "$2.o" "$OLDPWD/scripts/bench-scans.c" -o "$2" -lm -pthread -lz)
+}
+
+mkdir "$dir/before"
+git archive "$REV" | tar -x -C "$dir/before" || exit 1
+build "$dir/before" "$dir/bench-before" || exit 1
+build . "$dir/bench-after" || exit 1
+
+for which in before after; do
+    run=0
+    while [ $run -lt $RUNS ]; do
+        XDG_CACHE_HOME="$dir" script -qfc "stty rows 24 cols 80; '$dir/bench-$which' '$file' '$dir/out'" /dev/null >/dev/null </dev/null
+        cat "$dir/out" >>"$dir/$which.txt"
+        run=$((run + 1))
+    done
+    awk -v which="$which" 'NR == 1 || $2 < screen { screen = $2 } NR == 1 || $3 < save { save = $3 }
+        NR == 1 || $4 < find { find = $4 } { rows = $1 }
+        END { printf "%-7s %d rows: screen rows %.3fs, save length %.3fs, search %.3fs\n", which ":", rows, screen, save, find }' "$dir/$which.txt"
+done
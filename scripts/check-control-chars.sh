@@ -0,0 +1,59 @@
+#!/bin/sh
+# Opens a file with control characters in eddie, in a pseudo terminal: in a
+# row without tabs or wraps (shown straight from its chars), in a row with a
+# tab and in a soft wrapped row (both shown from a render of their own).
+# The check passes when every control character is drawn escaped - as a
+# marking letter in reverse video - and none of them reaches the terminal.
+#
+# usage: scripts/check-control-chars.sh [path to eddie] (default ./out/eddie)
+
+EDDIE=${1:-./out/eddie}
+WAIT=10 # most seconds to wait for the rows to be drawn
+
+dir=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; rm -rf "$dir"' EXIT
+
+file="$dir/control.txt"
+printf 'from chars \001 and \033 and \177 end\n' >"$file"
+printf '\tfrom render \002 end\n' >>"$file"
+awk 'BEGIN { for (i = 0; i < 30; i++) printf "wrapped "; printf "\003 end\n" }' >>"$file"
+
+# mark <letter> - a control character as drawn, the letter in reverse video
+mark() {
+    printf '\033[7m%s\033[m' "$1"
+}
+
+mkfifo "$dir/keys"
+XDG_CACHE_HOME="$dir" script -qfc "stty rows 24 cols 80; exec '$EDDIE' '$file'" /dev/null \
+    <"$dir/keys" >"$dir/screen" 2>&1 &
+pid=$!
+exec 3>"$dir/keys"
+
+i=0
+while ! grep -aqF "$(mark C)" "$dir/screen"; do
+    i=$((i + 1))
+    if [ $i -gt $WAIT ] || ! kill -0 $pid 2>/dev/null; then
+        echo "FAIL: the control character of the wrapped row was not drawn escaped"
+        exit 1
+    fi
+    sleep 1
+done
+printf '\021' >&3 # Ctrl-Q
+wait $pid
+
+for letter in A B; do
+    if ! grep -aqF "$(mark "$letter")" "$dir/screen"; then
+        echo "FAIL: no control character was drawn as $letter in reverse video"
+        exit 1
+    fi
+done
+if [ "$(grep -aoF "$(mark '?')" "$dir/screen" | wc -l)" -lt 2 ]; then
+    echo "FAIL: ESC and DEL in the row shown from its chars were not both drawn escaped"
+    exit 1
+fi
+raw=$(tr -dc '\001\002\003\177' <"$dir/screen" | wc -c)
+if [ "$raw" -ne 0 ]; then
+    echo "FAIL: $raw control characters of the file reached the terminal"
+    exit 1
+fi
+echo "ok: control characters drawn escaped from chars, from a render with tabs and from a wrapped render"
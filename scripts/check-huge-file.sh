@@ -0,0 +1,70 @@
+#!/bin/sh
+# Opens a sparse file of more than 4 GiB in eddie, in a pseudo terminal.
+# Most of the file is a single line of zeros - longer than a row can hold -
+# between two short lines. The check passes when all three lines are loaded,
+# typing into the long line is refused, and after typing into the first line
+# the file is saved with the long line written back whole.
+#
+# usage: scripts/check-huge-file.sh [path to eddie] (default ./out/eddie)
+
+EDDIE=${1:-./out/eddie}
+SIZE=5G
+WAIT=300 # most seconds to wait for the file to load, or the save to finish
+
+dir=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; rm -rf "$dir"' EXIT
+
+# wait_for <text> - waits for text to show up on the screen after what was shown so far
+wait_for() {
+    i=0
+    while ! tail -c +$((shown + 1)) "$dir/screen" | grep -q -- "$1"; do
+        i=$((i + 1))
+        if [ $i -gt $WAIT ] || ! kill -0 $pid 2>/dev/null; then
+            return 1
+        fi
+        sleep 1
+    done
+    shown=$(wc -c <"$dir/screen")
+}
+
+file="$dir/huge.txt"
+printf 'first line\n' >"$file"
+truncate -s "$SIZE" "$file" # a hole, no disk space is used for it
+printf '\nlast line\n' >>"$file"
+
+expected="$dir/expected.txt"
+printf 'Xfirst line\n' >"$expected"
+truncate -s "$SIZE" "$expected"
+truncate -s +1 "$expected" # the hole as long as in the file
+printf '\nlast line\n' >>"$expected"
+
+# the keys are fed through a fifo, so the editor reads them only once they are sent
+mkfifo "$dir/keys"
+XDG_CACHE_HOME="$dir" script -qfc "stty rows 24 cols 80; exec '$EDDIE' '$file'" /dev/null \
+    <"$dir/keys" >"$dir/screen" 2>&1 &
+pid=$!
+exec 3>"$dir/keys"
+shown=0
+
+if ! wait_for ' - 3 lines  '; then
+    echo "FAIL: $file was not loaded"
+    exit 1
+fi
+loaded=$i
+
+printf '\033[Bx' >&3 # down to the long line, type x
+if ! wait_for "Can't edit a line longer than"; then
+    echo "FAIL: typing into the cut short line was not refused"
+    exit 1
+fi
+
+printf '\033[AX\023' >&3 # up to the first line, type X, Ctrl-S
+if ! wait_for "bytes written to disk ("; then
+    echo "FAIL: the file with a cut short line was not saved"
+    exit 1
+fi
+if ! cmp "$file" "$expected"; then
+    echo "FAIL: the saved file is not as expected"
+    exit 1
+fi
+echo "ok: $(ls -l "$file" | awk '{ print $5 }') byte file opened in ${loaded}s, saved with its long line whole"
@@ -0,0 +1,82 @@
+#!/bin/sh
+# Opens a sparse file of more than 4 GiB in eddie, in a pseudo terminal, and
+# saves it twice: once after typing into a line near its end (only the tail
+# of the file is rewritten, in place past 4 GiB), and once after typing into
+# a line near its start (the whole file is written again). After each save
+# the file on disk is compared with the file it is expected to be.
+# The file is made of short lines around lines of zeros (holes, no disk
+# space is used for them), each short enough to be loaded whole.
+#
+# usage: scripts/check-save-huge.sh [path to eddie] (default ./out/eddie)
+
+EDDIE=${1:-./out/eddie}
+HOLES=36   # lines of zeros in the middle of the file
+HOLE=128M  # length of each of them
+LINES=1000 # short lines before and after them
+WAIT=300   # most seconds to wait for the file to load, or a save to finish
+
+dir=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; rm -rf "$dir"' EXIT
+
+# gen <file> <line typed into near the start> <line typed into near the end>
+gen() {
+    awk -v n=$LINES -v line="$2" 'BEGIN { for (i = 0; i < n; i++) print (i == n / 2) ? line : "head line " i }' >"$1"
+    i=0
+    while [ $i -lt $HOLES ]; do
+        truncate -s +$HOLE "$1"
+        printf '\n' >>"$1"
+        i=$((i + 1))
+    done
+    awk -v n=$LINES -v line="$3" 'BEGIN { for (i = 0; i < n; i++) print (i == n / 2) ? line : "tail line " i }' >>"$1"
+}
+
+# wait_for <text> - waits for text to show up on the screen after what was shown so far
+wait_for() {
+    i=0
+    while ! tail -c +$((shown + 1)) "$dir/screen" | grep -q -- "$1"; do
+        i=$((i + 1))
+        if [ $i -gt $WAIT ] || ! kill -0 $pid 2>/dev/null; then
+            return 1
+        fi
+        sleep 1
+    done
+    shown=$(wc -c <"$dir/screen")
+}
+
+file="$dir/huge.txt"
+gen "$file" '@head@ line' '@tail@ line'
+gen "$dir/tail.txt" '@head@ line' '@tail@X line'
+gen "$dir/both.txt" '@head@Y line' '@tail@X line'
+
+mkfifo "$dir/keys"
+XDG_CACHE_HOME="$dir" script -qfc "stty rows 24 cols 80; exec '$EDDIE' '$file'" /dev/null \
+    <"$dir/keys" >"$dir/screen" 2>&1 &
+pid=$!
+exec 3>"$dir/keys"
+shown=0
+
+if ! wait_for " - $((2 * LINES + HOLES)) lines  "; then
+    echo "FAIL: $file was not loaded"
+    exit 1
+fi
+
+printf '\006@tail@\rX\023' >&3 # Ctrl-F to the line near the end, type X, Ctrl-S
+if ! wait_for "written to disk from byte"; then
+    echo "FAIL: the tail of the file was not saved in place"
+    exit 1
+fi
+if ! cmp "$file" "$dir/tail.txt"; then
+    echo "FAIL: the file saved from its tail is not as expected"
+    exit 1
+fi
+
+printf '\006@head@\rY\023' >&3 # to the line near the start, type Y, save
+if ! wait_for "bytes written to disk ("; then
+    echo "FAIL: the whole file was not saved"
+    exit 1
+fi
+if ! cmp "$file" "$dir/both.txt"; then
+    echo "FAIL: the file saved whole is not as expected"
+    exit 1
+fi
+echo "ok: $(ls -l "$file" | awk '{ print $5 }') byte file saved from its tail and whole"
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Types, deletes and moves around (by char and by screen row) in a long soft
+# wrapped row in a debug build of eddie, in a pseudo terminal. A debug build
+# lays every edited row out whole as well, and aborts if that differs from the
+# layout of the edit (the render, wraps and wrap stops) - the check fails
+# unless eddie exits cleanly.
+# Its debug prints then show that every edit laid out only the edited part of
+# the row - the row is laid out in full only once, when it is first displayed.
+#
+# usage: scripts/check-wrap-edit.sh (from the top of the repository)
+
+OPS=400 # keys sent, typed chars, spaces, tabs, backspaces and arrows
+WAIT=20 # most seconds to wait for the keys to be handled
+
+dir=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; rm -rf "$dir"' EXIT
+
+make -s debug OUTPUT_DIR="$dir" || exit 1
+
+# a row of 20000 words, wrapped over a few thousand screen rows
+file="$dir/long.txt"
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "word%d ", i; printf "\nnext line\n" }' >"$file"
+size=$(head -n 1 "$file" | wc -c)
+size=$((size - 1))
+
+# the keys, after moving into the row: mostly chars, spaces and tabs typed
+# around the wraps, some deleted again, with the cursor moved on now and then
+awk -v n=$OPS -v keys="$dir/keys.txt" 'BEGIN {
+    srand(1)
+    for (i = 0; i < 100; i++) printf "\033[C" >keys
+    for (i = 0; i < n; i++) {
+        r = rand()
+        if (r < 0.40) { printf "%c", 97 + int(rand() * 26) >keys; edits++ }
+        else if (r < 0.60) { printf " " >keys; edits++ }
+        else if (r < 0.70) { printf "\t" >keys; edits++ }
+        else if (r < 0.85) { printf "\177" >keys; edits++ }
+        else if (r < 0.93) { for (k = int(rand() * 30); k >= 0; k--) printf "\033[C" >keys }
+        else if (r < 0.96) { for (k = int(rand() * 10); k >= 0; k--) printf "\033[D" >keys }
+        else if (r < 0.98) printf "\033[B" >keys
+        else printf "\033[A" >keys
+    }
+    print edits
+}' >"$dir/edits"
+edits=$(cat "$dir/edits")
+
+mkfifo "$dir/keys"
+XDG_CACHE_HOME="$dir" script -qefc "stty rows 24 cols 80; exec '$dir/eddie' '$file' 2>'$dir/log'" /dev/null \
+    <"$dir/keys" >"$dir/screen" 2>&1 &
+pid=$!
+exec 3>"$dir/keys"
+
+sleep 1
+cat "$dir/keys.txt" >&3
+i=0
+while [ "$(grep -c "edit at .* of a row of" "$dir/log")" -lt $edits ]; do
+    i=$((i + 1))
+    if [ $i -gt $WAIT ] || ! kill -0 $pid 2>/dev/null; then
+        grep -h "differs" "$dir/log"
+        echo "FAIL: $(grep -c "edit at .* of a row of" "$dir/log") of the $edits edits were laid out as an edit"
+        exit 1
+    fi
+    sleep 1
+done
+
+printf '\021\021\021\021' >&3 # Ctrl-Q, once more than asked to quit without saving
+wait $pid
+status=$?
+if [ $status -ne 0 ]; then
+    grep -h "differs" "$dir/log"
+    echo "FAIL: eddie exited with status $status"
+    exit 1
+fi
+
+full=$(sed -n 's/.*a row of \([0-9]*\) chars in full/\1/p' "$dir/log" | awk -v size=$size '$1 >= size' | wc -l)
+if [ "$full" -ne 1 ]; then
+    echo "FAIL: the $size char row was laid out in full $full times"
+    exit 1
+fi
+echo "ok: $edits edits of a $size char row laid out as the whole row would be, laid out in full once"
@@ -1,15 +1,22 @@
 #include "syshead.h"
 
 #include "search.h"
+#include "buffer.h"
 #include "highlight.h"
+#include "rowidx.h"
 #include "terminal.h"
+#include "window.h"
 
 void editorFindCallback(eState *state, char *query, int key) {
     static int last_match = -1;
     static int direction = 1;
 
+    if (last_match >= state->numrows)
+        last_match = -1; // follow mode dropped the row since, search from the start again
     if (last_match != -1) {
-        memset(state->row[last_match].bg, BG_NORMAL, state->row[last_match].rsize); // cleanup the previous match
+        erow *row = editorRow(state, last_match);
+        if (row->rd) // not unloaded since
+            memset(row->rd->bg, BG_NORMAL, row->rd->rsize); // cleanup the previous match
     }
 
     if (key == '\r' || key == ESCAPE) { // exit search
@@ -25,25 +32,38 @@ void editorFindCallback(eState *state, char *query, int key) {
         direction = 1;
     }
 
+    if (state->numrows == 0)
+        return; // nothing to search
     if (last_match == -1)
         direction = 1;
     int current = last_match;
+    int steps = state->numrows;
+    if (editorTotalRows(state) > state->numrows)
+        steps++; // one step past the last row, to search beyond the window
     int i;
-    for (i = 0; i < state->numrows; i++) {
+    for (i = 0; i < steps; i++) {
         current += direction;
-        if (current == -1)
-            current = state->numrows - 1;
-        else if (current == state->numrows)
-            current = 0;
+        if (current == -1 || current == state->numrows) {
+            int found = editorWindowFind(state, query, direction); // past the edge of the loaded rows
+            if (found != -1)
+                current = found;
+            else if (current == -1)
+                current = state->numrows - 1;
+            else
+                current = 0;
+        }
 
-        erow *row = &state->row[current];
-        char *match = strstr(row->render, query);
+        erow *row = editorRow(state, current);
+        editorRowFlatten(row);
+        if (!memmem(row->chars, ROW_SIZE(row), query, strlen(query)))
+            continue; // check the raw row first, so rows are only rendered if they match
+        editorPrepareRow(state, row);
+        char *render = editorRowRender(row);
+        char *match = memmem(render, row->rd->rsize, query, strlen(query));
         if (match) {
             last_match = current;
-            editorStepCursor(state, ARROW_DOWN, current - state->cy);
-            int match_cx = editorRowRxToCx(row, match - row->render);
-            match_cx += strlen(query);
-            editorStepCursor(state, ARROW_RIGHT, match_cx - state->cx);
+            int match_cx = editorRowRxToCx(row, match - render);
+            editorSetCursor(state, current, match_cx + strlen(query)); // the rows up to the match stay unrendered
             state->rowoff = state->numrows;
             editorScroll(state);
 #ifdef DO_SOFTWRAP
@@ -51,7 +71,7 @@ void editorFindCallback(eState *state, char *query, int key) {
             state->ix = recalcIx(state);
 #endif /* DO_SOFTWRAP */
 
-            memset(&row->bg[match - row->render], BG_MATCH, strlen(query));
+            memset(&row->rd->bg[match - render], BG_MATCH, strlen(query));
             break;
         }
     }
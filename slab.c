@@ -0,0 +1,213 @@
+#include "syshead.h"
+
+#include "slab.h"
+#include "consts.h"
+
+#define SLAB_MIN_SHIFT 4 // the smallest size class is 16 bytes
+#define SLAB_CLASSES 10  // size classes of 16 bytes to 8KB, larger blocks get their own allocation
+#define SLAB_HEAD ((sizeof(struct slab) + 15) & ~(size_t)15) // blocks start 16 byte aligned after the head
+
+/**
+ * @brief The head of a slab, at its EDDIE_SLAB_SIZE aligned start - so the
+ *        slab of a block is found by masking its address. A large block is
+ *        a slab of its own, as long as the block needs.
+ *
+ * {
+ *      int cls; (size class of the blocks, -1 for a large block)
+ *      int used; (number of blocks handed out)
+ *      size_t size; (number of bytes of a large block)
+ *      char *free; (list of freed blocks, linked through their first bytes)
+ *      char *fresh; (start of the blocks never handed out)
+ *      struct slab *prev, *next; (neighbours in the list of slabs of the class with free blocks)
+ * }
+ */
+struct slab {
+    int cls;
+    int used;
+    size_t size;
+    char *free;
+    char *fresh;
+    struct slab *prev, *next;
+};
+
+/**
+ * @brief The slabs of a size class.
+ *
+ * {
+ *      struct slab *partial; (slabs with free blocks)
+ *      struct slab *spare; (an empty slab kept for reuse, NULL if none)
+ * }
+ */
+struct sizeClass {
+    struct slab *partial;
+    struct slab *spare;
+};
+
+static struct sizeClass classes[SLAB_CLASSES];
+static struct slabStats stats;
+
+/**
+ * @brief The slab a block was carved out of.
+ *
+ * @param ptr (the block)
+ * @return struct slab* (the slab)
+ */
+static struct slab *slab_of(void *ptr) {
+    return (struct slab *)((uintptr_t)ptr & ~(uintptr_t)(EDDIE_SLAB_SIZE - 1));
+}
+
+/**
+ * @brief Whether every block of a slab was handed out.
+ *
+ * @param slab (the slab)
+ * @return int (whether the slab is full)
+ */
+static int slab_full(struct slab *slab) {
+    return slab->free == NULL && slab->fresh + ((size_t)1 << (slab->cls + SLAB_MIN_SHIFT)) > (char *)slab + EDDIE_SLAB_SIZE;
+}
+
+/**
+ * @brief Adds a slab to the slabs of its class with free blocks.
+ *
+ * @param slab (the slab)
+ */
+static void link_slab(struct slab *slab) {
+    struct sizeClass *cls = &classes[slab->cls];
+    slab->prev = NULL;
+    slab->next = cls->partial;
+    if (cls->partial)
+        cls->partial->prev = slab;
+    cls->partial = slab;
+}
+
+/**
+ * @brief Removes a slab from the slabs of its class with free blocks.
+ *
+ * @param slab (the slab)
+ */
+static void unlink_slab(struct slab *slab) {
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        classes[slab->cls].partial = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+/**
+ * @brief Allocates an aligned slab from the system.
+ *
+ * @param size (number of bytes, including the head)
+ * @return struct slab* (the slab)
+ */
+static struct slab *new_slab(size_t size) {
+    void *ptr;
+    if (posix_memalign(&ptr, EDDIE_SLAB_SIZE, size) != 0)
+        return NULL;
+    struct slab *slab = ptr;
+    slab->used = 0;
+    slab->free = NULL;
+    slab->fresh = (char *)slab + SLAB_HEAD;
+    stats.slabs++;
+    stats.reserved += size;
+    return slab;
+}
+
+/**
+ * @brief Gives a slab back to the system.
+ *
+ * @param slab (the slab)
+ * @param size (number of bytes, including the head)
+ */
+static void free_slab(struct slab *slab, size_t size) {
+    stats.slabs--;
+    stats.reserved -= size;
+    free(slab);
+}
+
+void *slabAlloc(size_t size) {
+    int cls = 0;
+    while (((size_t)1 << (cls + SLAB_MIN_SHIFT)) < size)
+        cls++;
+    if (cls >= SLAB_CLASSES) {
+        struct slab *slab = new_slab(SLAB_HEAD + size);
+        if (slab == NULL)
+            return NULL;
+        slab->cls = -1;
+        slab->size = size;
+        stats.used += size;
+        return (char *)slab + SLAB_HEAD;
+    }
+
+    struct slab *slab = classes[cls].partial;
+    if (slab == NULL) {
+        slab = classes[cls].spare;
+        classes[cls].spare = NULL;
+        if (slab == NULL && (slab = new_slab(EDDIE_SLAB_SIZE)) == NULL)
+            return NULL;
+        slab->cls = cls;
+        link_slab(slab);
+    }
+
+    size_t bsize = (size_t)1 << (cls + SLAB_MIN_SHIFT);
+    char *block = slab->free;
+    if (block != NULL) {
+        slab->free = *(char **)block;
+    } else {
+        block = slab->fresh;
+        slab->fresh += bsize;
+    }
+    slab->used++;
+    stats.used += bsize;
+    if (slab_full(slab))
+        unlink_slab(slab);
+    return block;
+}
+
+void *slabRealloc(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return slabAlloc(size);
+    struct slab *slab = slab_of(ptr);
+    size_t cap = (slab->cls == -1) ? slab->size : (size_t)1 << (slab->cls + SLAB_MIN_SHIFT);
+    if (size <= cap)
+        return ptr;
+    if (slab->cls == -1 && size < cap + cap / 2)
+        size = cap + cap / 2; // a large block grown a bit at a time is not copied every time
+
+    void *moved = slabAlloc(size);
+    if (moved == NULL)
+        return NULL;
+    memcpy(moved, ptr, cap);
+    slabFree(ptr);
+    return moved;
+}
+
+void slabFree(void *ptr) {
+    if (ptr == NULL)
+        return;
+    struct slab *slab = slab_of(ptr);
+    if (slab->cls == -1) {
+        stats.used -= slab->size;
+        free_slab(slab, SLAB_HEAD + slab->size);
+        return;
+    }
+
+    if (slab_full(slab))
+        link_slab(slab); // has a free block again
+    *(char **)ptr = slab->free;
+    slab->free = ptr;
+    slab->used--;
+    stats.used -= (size_t)1 << (slab->cls + SLAB_MIN_SHIFT);
+    if (slab->used > 0)
+        return;
+
+    unlink_slab(slab);
+    if (classes[slab->cls].spare == NULL)
+        classes[slab->cls].spare = slab; // saves going to the system for a row that is rendered again
+    else
+        free_slab(slab, EDDIE_SLAB_SIZE);
+}
+
+void slabGetStats(struct slabStats *out) {
+    *out = stats;
+}
@@ -2,11 +2,18 @@
 
 #include "terminal.h"
 #include "buffer.h"
+#include "cache.h"
 #include "consts.h"
 #include "editor.h"
 #include "file.h"
+#include "follow.h"
 #include "highlight.h"
+#include "journal.h"
+#include "rowidx.h"
 #include "search.h"
+#include "slab.h"
+#include "window.h"
+#include "wrap.h"
 
 /*** terminal ***/
 
@@ -27,6 +34,17 @@ void disableRawMode() {
     printf("\n");
 }
 
+int editorStdinFromTty() {
+    if (isatty(STDIN_FILENO))
+        return -1;
+    int fd = dup(STDIN_FILENO);
+    int tty = open("/dev/tty", O_RDWR);
+    if (fd == -1 || tty == -1 || dup2(tty, STDIN_FILENO) == -1)
+        die("/dev/tty");
+    close(tty);
+    return fd;
+}
+
 void enableRawMode() {
     if (tcgetattr(STDIN_FILENO, &orig_termios) == -1)
         die("tcgetattr");
@@ -48,9 +66,10 @@ void enableRawMode() {
 int editorReadKey() {
     int nread;
     char c;
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
+    if ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
         if (nread == -1 && errno != EAGAIN)
             die("read");
+        return NO_KEY;
     }
 
     if (c == ESCAPE) { // process escape control characters and convert to key codes
@@ -114,6 +133,20 @@ int editorReadKey() {
     }
 }
 
+int editorWaitKey(eState *state) {
+    int c;
+    while ((c = editorReadKey()) == NO_KEY) {
+        editorJournalCommit(state); // idle - sync the edits typed so far at once
+        int redraw = editorSavePoll(state);
+        redraw |= editorFollowPoll(state);
+        redraw |= editorPipePoll(state);
+        redraw |= editorLoadPoll(state);
+        if (redraw)
+            return NO_KEY; // background work changed the editor state
+    }
+    return c;
+}
+
 int getCursorPosition(int *rows, int *cols) {
     char buf[32];
     unsigned int i = 0;
@@ -158,15 +191,19 @@ int getWindowSize(int *rows, int *cols) {
 }
 
 int recalcIy(eState *state) {
-    int y;
-    int iy = state->wrapoff; // offset into current row
+    // only the rows displayed above the cursor count, make sure their wraps are calculated
+    int last = state->cy;
+    if (last > state->numrows)
+        last = state->numrows;
+    if (last > state->rowoff + state->editrows)
+        last = state->rowoff + state->editrows;
+    if (last <= state->rowoff)
+        return state->wrapoff; // offset into current row
+    for (int y = state->rowoff; y < last; y++)
+        editorPrepareRow(state, editorRow(state, y));
     // add the number of wraps in all previously displayed rows
-    for (y = state->rowoff; y < state->cy; y++) {
-        if (y >= state->numrows || y - state->rowoff >= state->editrows)
-            return iy;
-        iy += state->row[y].wraps;
-    }
-    return iy;
+    long long lines = wrapScreenRow(state, last, 0) - wrapScreenRow(state, state->rowoff, 0);
+    return state->wrapoff + (int)lines - (last - state->rowoff);
 }
 
 int recalcIx(eState *state) {
@@ -175,11 +212,12 @@ int recalcIx(eState *state) {
     int ix = 0;
     int cx = state->cx;
     int i;
-    erow *row = &state->row[state->cy];
-    for (i = 0; i <= row->wraps; i++) {
-        if (cx > row->wrap_stops[i]) {
-            cx -= row->wrap_stops[i];
-            ix -= row->wrap_stops[i];
+    erow *row = editorRow(state, state->cy);
+    editorPrepareRow(state, row);
+    for (i = 0; i <= ROW_WRAPS(row); i++) {
+        if (cx > row->rd->wrap_stops[i]) {
+            cx -= row->rd->wrap_stops[i];
+            ix -= row->rd->wrap_stops[i];
         }
     }
     return ix;
@@ -190,15 +228,28 @@ int recalcIx(eState *state) {
 void editorScroll(eState *state) {
     state->rx = 0;
     if (state->cy < state->numrows) {
-        state->rx = editorRowCxToRx(&state->row[state->cy], state->cx); // calculate rx from cx, if not on last row
+        state->rx = editorRowCxToRx(editorRow(state, state->cy), state->cx); // calculate rx from cx, if not on last row
     }
 
     if (state->cy < state->rowoff) { // location is higher than screen, scroll up
         state->rowoff = state->cy;
-        state->iy = 0; // the cursor is on the top row
+        state->iy = state->wrapoff; // the cursor row is the top row
     }
     if (state->cy + state->iy >= state->rowoff + state->editrows) { // location is lower than screen, scroll down
-        state->rowoff = state->cy + state->iy - state->editrows + 1;
+        // the rows that stay displayed above the cursor need their wraps calculated
+        int shown = state->wrapoff + 1;
+        for (int y = state->cy - 1; y >= 0 && shown < state->editrows; y--) {
+            erow *row = editorRow(state, y);
+            editorPrepareRow(state, row);
+            shown += ROW_WRAPS(row) + 1;
+        }
+        int wrap;
+        long long top = wrapScreenRow(state, state->cy, state->wrapoff) - state->editrows + 1; // first screen row to display
+        state->rowoff = wrapFileRow(state, top, &wrap);
+        if (wrap > 0)
+            state->rowoff++; // rows are displayed from their first wrap on
+        if (state->rowoff > state->cy)
+            state->rowoff = state->cy;
         state->iy = recalcIy(state); // wrapped rows were possibly scrolled over, recalculate iy in case it changed
     }
 #ifndef DO_SOFTWRAP
@@ -234,7 +285,9 @@ void editorDrawRows(eState *state, struct abuf *ab) {
                 abAppend(ab, "~", 1);
             }
         } else {
-            int len = state->row[filerow].rsize;
+            erow *row = editorRow(state, filerow);
+            editorPrepareRow(state, row); // rows are only rendered once they are displayed
+            int len = row->rd->rsize;
 #ifndef DO_SOFTWRAP
             len -= state->coloff;
 #endif /* DO_SOFTWRAP */
@@ -248,13 +301,13 @@ void editorDrawRows(eState *state, struct abuf *ab) {
             // create line numbering column
             abAppend(ab, LINENUM_STYLE_ON, strlen(LINENUM_STYLE_ON));
             char buf[state->linenum_w + 1];
-            snprintf(buf, sizeof(buf), "%*d", state->linenum_w - 1, state->row[filerow].idx + 1);
+            snprintf(buf, sizeof(buf), "%*lld", state->linenum_w - 1, state->winfirst + filerow + 1);
             abAppend(ab, buf, strlen(buf));
             abAppend(ab, LINENUM_STYLE_OFF " ", strlen(LINENUM_STYLE_OFF) + 1);
 
-            char *content = state->row[filerow].render;
-            unsigned char *hl = state->row[filerow].hl;
-            unsigned char *bg = state->row[filerow].bg;
+            char *content = editorRowRender(row);
+            unsigned char *hl = row->rd->hl;
+            unsigned char *bg = row->rd->bg;
 #ifndef DO_SOFTWRAP // if no softwrap, position properly in arrays
             content = &content[state->coloff];
             hl = &hl[state->coloff];
@@ -322,13 +375,21 @@ void editorDrawRows(eState *state, struct abuf *ab) {
 
 void editorDrawStatusBar(eState *state, struct abuf *ab) {
     abAppend(ab, ANSI_REVERSE_VIDEO, 4);
-    char status[80], rstatus[80];
-    int len = snprintf(status, sizeof(status), "%.20s - %d lines %s",
-                       state->filename ? state->filename : "[No Name]", state->numrows,
-                       state->dirty ? "(modified)" : ""); // {filename} - {count} lines (modified)
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d",
+    char status[80], rstatus[80], loading[20] = "", used[16], budget[16];
+    int progress = editorLoadProgress(state);
+    if (progress != -1)
+        snprintf(loading, sizeof(loading), "(loading %d%%)", progress);
+    int len = snprintf(status, sizeof(status), "%.20s - %lld lines %s%s%s",
+                       state->filename ? state->filename : "[No Name]", editorTotalRows(state),
+                       state->dirty ? "(modified)" : "", state->follow ? "(following)" : "",
+                       loading); // {filename} - {count} lines (modified)(following)(loading N%)
+    struct slabStats stats;
+    slabGetStats(&stats);
+    editorFormatSize(used, sizeof(used), stats.used);
+    editorFormatSize(budget, sizeof(budget), state->rowbudget);
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s/%s | %s | %lld/%lld", used, budget,
                         state->syntax ? state->syntax->filetype : "plaintext",
-                        state->cy + 1, state->numrows); // {syntax} | {curline}/{countlines}
+                        state->winfirst + state->cy + 1, editorTotalRows(state)); // {rendered}/{budget} | {syntax} | {curline}/{countlines}
     if (len > state->screencols)
         len = state->screencols;
     abAppend(ab, status, len);
@@ -363,6 +424,7 @@ void editorRefreshScreen(eState *state) {
     abAppend(&ab, ANSI_HOME_CURSOR, 3);
 
     editorDrawRows(state, &ab);
+    editorTrimRowMemory(state); // the rows on the screen were just rendered
     editorDrawStatusBar(state, &ab);
     editorDrawMessageBar(state, &ab);
 
@@ -401,7 +463,9 @@ char *editorPrompt(eState *state, char *prompt, void (*callback)(eState *, char
         editorSetStatusMessage(state, prompt, buf);
         editorRefreshScreen(state);
 
-        int c = editorReadKey();
+        int c = editorWaitKey(state);
+        if (c == NO_KEY)
+            continue; // only redraw
         if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) { // deleting keys
             if (buflen != 0)
                 buf[--buflen] = '\0';
@@ -432,101 +496,82 @@ char *editorPrompt(eState *state, char *prompt, void (*callback)(eState *, char
     }
 }
 
+/**
+ * @brief Moves the cursor to the screen row above or below it, keeping its
+ *        column as far as the wrap it lands on goes. Past the last row the
+ *        cursor lands on the empty line after it.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param dir (-1 for the screen row above, 1 for the one below)
+ */
+static void move_screen_row(eState *state, int dir) {
+    // the cursor may land on the row above, make sure its wraps are calculated
+    for (int y = state->cy - 1; y <= state->cy; y++) {
+        if (y >= 0 && y < state->numrows)
+            editorPrepareRow(state, editorRow(state, y));
+    }
+    long long line = wrapScreenRow(state, state->cy, state->wrapoff) + dir;
+    if (line < 0)
+        return;
+    int col = state->cx + state->ix; // column in the current wrap
+    int wrap;
+    int cy = wrapFileRow(state, line, &wrap);
+    if (cy >= state->numrows) {
+        editorSetCursor(state, state->numrows, 0);
+        return;
+    }
+
+    erow *row = editorRow(state, cy);
+    editorPrepareRow(state, row);
+    int start = 0; // first char of the wrap
+    for (int w = 0; w < wrap; w++)
+        start += row->rd->wrap_stops[w];
+    int end = (wrap < ROW_WRAPS(row)) ? start + row->rd->wrap_stops[wrap] : ROW_SIZE(row);
+    int cx = start + col;
+    if (wrap > 0 && col == 0)
+        cx++; // the start of a wrap is shown at the end of the wrap before it
+    editorSetCursor(state, cy, cx < end ? cx : end);
+}
+
 void editorMoveCursor(eState *state, int key) {
-    erow *row = (state->cy >= state->numrows) ? NULL : &state->row[state->cy]; // current row
+    erow *row = (state->cy >= state->numrows) ? NULL : editorRow(state, state->cy); // current row
 
     switch (key) {
     case ARROW_LEFT:
-        if (state->cx != 0) {
-#ifdef DO_SOFTWRAP
-            if (state->cx + state->ix == 0 && state->iy > 0) { // Leftmost column reached on a wrapped row - go one wrap up and land on rightmost column
-                state->wrapoff -= 1;
-                state->ix += state->row[state->cy].wrap_stops[state->wrapoff];
-                state->iy -= 1;
-            }
-#endif /* DO_SOFTWRAP */
-            state->cx--;
-        } else if (state->cy > 0) { // was on beginning of row - go one row up
-            state->cy--;
-            state->cx = state->row[state->cy].size;
-#ifdef DO_SOFTWRAP
-            // add all wraps for previous row to land on end
-            state->wrapoff = state->row[state->cy].wraps;
-            state->ix = 0;
-            for (int wr = 0; wr < state->wrapoff; wr++) { // recalculate ix (maybe can replace by recalcIx)
-                state->ix -= state->row[state->cy].wrap_stops[wr];
-            }
-#endif /* DO_SOFTWRAP */
-        }
+        if (state->cx != 0)
+            editorSetCursor(state, state->cy, state->cx - 1);
+        else if (state->cy > 0) // was on beginning of row - go to the end of the row above
+            editorSetCursor(state, state->cy - 1, ROW_SIZE(editorRow(state, state->cy - 1)));
         break;
     case ARROW_RIGHT:
-        if (row && state->cx < row->size) {
-#ifdef DO_SOFTWRAP
-            int current_wrapstop = state->row[state->cy].wrap_stops[state->wrapoff];
-            if (state->cx + state->ix >= current_wrapstop) { // passed a wrap stop, go to beginning of next wrap
-                state->ix -= current_wrapstop;
-                state->iy += 1;
-                state->wrapoff += 1;
-            }
-#endif /* DO_SOFTWRAP */
-            state->cx++;
-        } else if (row && state->cx == row->size) { // was on end of row, go to beginning of next row
-            state->cy++;
-            state->cx = 0;
-#ifdef DO_SOFTWRAP
-            state->ix = 0;
-            state->wrapoff = 0;
-#endif /* DO_SOFTWRAP */
-        }
+        if (row && state->cx < ROW_SIZE(row))
+            editorSetCursor(state, state->cy, state->cx + 1);
+        else if (row) // was on end of row, go to beginning of next row
+            editorSetCursor(state, state->cy + 1, 0);
         break;
     case ARROW_UP:
-        if (state->cy != 0) {
-#ifdef DO_SOFTWRAP
-            // fix wrapping to match the previous row's length and stops
-            state->iy -= state->wrapoff + state->row[state->cy - 1].wraps;
-            int cx = state->cx;
-            int wo;
-            for (wo = 0; wo < state->row[state->cy - 1].wraps; wo++) {
-                cx -= state->row[state->cy - 1].wrap_stops[wo];
-                if (cx < 0)
-                    break;
-            }
-            state->wrapoff = wo;
-            state->iy += state->wrapoff;
-#endif /* DO_SOFTWRAP */
-            state->cy--;
-        }
+        move_screen_row(state, -1);
         break;
     case ARROW_DOWN:
-        if (state->cy < state->numrows) {
-#ifdef DO_SOFTWRAP
-            // fix wrapping to match the next row's length and stops
-            state->iy += state->row[state->cy].wraps - state->wrapoff;
-            if (state->row[state->cy + 1].wraps < state->wrapoff)
-                state->wrapoff = state->row[state->cy + 1].wraps;
-            state->iy += state->wrapoff;
-            state->ix = 0;
-            for (int wr = 0; wr < state->wrapoff; wr++) {
-                state->ix -= state->row[state->cy - 1].wrap_stops[wr];
-            }
-#endif /* DO_SOFTWRAP */
-            state->cy++;
-        }
+        move_screen_row(state, 1);
         break;
     }
+}
 
-    row = (state->cy >= state->numrows) ? NULL : &state->row[state->cy];
-    int rowlen = row ? row->size : 0;
-    if (state->cx > rowlen) { // limit cx as it was not limited in the switch case
-        state->cx = rowlen;
+void editorSetCursor(eState *state, int cy, int cx) {
+    state->cy = cy;
+    state->cx = cx;
+    state->wrapoff = 0;
 #ifdef DO_SOFTWRAP
-        state->wrapoff = state->row[state->cy].wraps;
-        state->ix = 0;
-        for (int wr = 0; wr < state->wrapoff; wr++) {
-            state->ix -= state->row[state->cy].wrap_stops[wr];
-        }
-#endif /* DO_SOFTWRAP */
+    if (cy < state->numrows) {
+        erow *row = editorRow(state, cy);
+        editorPrepareRow(state, row);
+        while (state->wrapoff < ROW_WRAPS(row) && cx > row->rd->wrap_stops[state->wrapoff]) // past a wrap stop, on the next wrap
+            cx -= row->rd->wrap_stops[state->wrapoff++];
     }
+    state->ix = recalcIx(state);
+    state->iy = recalcIy(state);
+#endif /* DO_SOFTWRAP */
 }
 
 void editorStepCursor(eState *state, int key, int steps) {
@@ -555,19 +600,25 @@ void editorStepCursor(eState *state, int key, int steps) {
 void editorProcessKeypress(eState *state) {
     static int quit_times = EDDIE_QUIT_TIMES;
 
-    int c = editorReadKey();
+    int c = editorWaitKey(state);
 
     switch (c) {
+    case NO_KEY: // only redraw
+        return;
+
     case '\r': // ENTER
         editorInsertNewLine(state);
         break;
 
     case CTRL_KEY('q'):
+        editorSaveWait(state); // don't leave a save half-written
         if (state->dirty && quit_times > 0) {
             editorSetStatusMessage(state, "File has unsaved hanges. Press Ctrl-Q %d more times to quit.", quit_times);
             quit_times--;
             return;
         }
+        editorJournalClose(state); // the edits were saved, or are thrown away
+        editorCacheClose(state);
         write(STDOUT_FILENO, ANSI_CLEAR_SCREEN, 4);
         write(STDOUT_FILENO, ANSI_HOME_CURSOR, 3);
         exit(0);
@@ -577,6 +628,14 @@ void editorProcessKeypress(eState *state) {
         editorSave(state);
         break;
 
+    case CTRL_KEY('t'):
+        editorFollowToggle(state);
+        break;
+
+    case CTRL_KEY('g'):
+        editorShowRowMemory(state);
+        break;
+
     case CTRL_KEY('f'):
 #ifdef VSCODE
     case CTRL_KEY('r'): // hack for testing in vscode
@@ -585,12 +644,12 @@ void editorProcessKeypress(eState *state) {
         break;
 
     case HOME_KEY:
-        editorStepCursor(state, ARROW_LEFT, state->cx);
+        editorSetCursor(state, state->cy, 0);
         break;
 
     case END_KEY:
         if (state->cy < state->numrows)
-            editorStepCursor(state, ARROW_RIGHT, state->row[state->cy].size - state->cx);
+            editorSetCursor(state, state->cy, ROW_SIZE(editorRow(state, state->cy)));
         break;
 
     case BACKSPACE:
@@ -0,0 +1,300 @@
+#include "syshead.h"
+
+#include "window.h"
+#include "buffer.h"
+#include "cache.h"
+#include "consts.h"
+#include "file.h"
+#include "lineidx.h"
+#include "rowidx.h"
+#include "structs.h"
+
+/**
+ * @brief Creates an unlinked temporary file to keep the line index in.
+ * 
+ * @return int (descriptor of the file, -1 if none could be created - the index stays on the heap)
+ */
+static int index_file(void) {
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0')
+        dir = "/tmp";
+
+    size_t len = strlen(dir) + sizeof("/eddie-lines-XXXXXX");
+    char *path = malloc(len);
+    snprintf(path, len, "%s/eddie-lines-XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path); // the file is gone once the editor exits
+    free(path);
+    return fd;
+}
+
+/**
+ * @brief Loads @count lines after the window at the end of the row array.
+ *        If no row was changed on disk so far, the loaded rows are known to
+ *        be unchanged on disk as well.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param count (number of lines loaded)
+ */
+static void load_after(eState *state, int count) {
+    struct lineidx *lines = state->lines;
+    int at = state->numrows;
+    int clean = (state->modrow == at);
+
+    editorLoadRows(state, at, state->map, lines, state->winlast, count);
+    state->winlast += count;
+    if (!clean)
+        return;
+
+    for (int j = at; j < state->numrows && state->modoff != -1; j++)
+        state->modoff += editorRowFileLen(state, editorRow(state, j));
+    state->modrow = state->numrows;
+    if (state->winlast == lines->count && lines->off[lines->count] > state->mapsize) {
+        state->modrow--; // the last line has no newline, saving adds it
+        if (state->modoff != -1)
+            state->modoff -= editorRowFileLen(state, editorRow(state, state->modrow));
+    }
+}
+
+/**
+ * @brief Loads @count lines before the window at the start of the row array.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param count (number of lines loaded)
+ */
+static void load_before(eState *state, int count) {
+    state->winfirst -= count;
+    editorLoadRows(state, 0, state->map, state->lines, state->winfirst, count);
+    state->cy += count;
+    state->rowoff += count;
+}
+
+/**
+ * @brief Finds the last occurrence of a string in a buffer.
+ * 
+ * @param buf (the searched buffer)
+ * @param len (length of buf)
+ * @param query (the searched string)
+ * @param qlen (length of query)
+ * @return char* (the last match, NULL if none)
+ */
+static char *find_last(char *buf, size_t len, const char *query, size_t qlen) {
+    char *last = NULL;
+    char *match = buf;
+    while ((match = memmem(match, len - (match - buf), query, qlen)) != NULL)
+        last = match++;
+    return last;
+}
+
+int editorWindowOpen(eState *state, int fd, size_t size) {
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    struct lineidx *lines = malloc(sizeof(struct lineidx));
+    *lines = (struct lineidx)LINEIDX_INIT;
+    lines->fd = index_file();
+    state->map = map;
+    state->mapsize = size;
+    state->map_current = 1;
+    state->lines = lines;
+    state->disksize = size;
+    state->modrow = 0;
+    state->modoff = 0;
+    if (editorCacheLoad(state, fd, lines) == -1)
+        editorLoadStart(state, fd); // the index grows in the background, the window loads lines as they come
+
+    editorSetLineCount(state, lines->count); // the numbering column fits the whole file, not just the window
+    load_after(state, lines->count < EDDIE_WINDOW_ROWS ? lines->count : EDDIE_WINDOW_ROWS);
+    return 0;
+}
+
+void editorWindowFollow(eState *state) {
+    if (state->lines == NULL)
+        return;
+    int margin = EDDIE_WINDOW_ROWS / 2;
+
+    if (state->cy < margin && state->winfirst > 0) {
+        int count = EDDIE_WINDOW_ROWS - state->cy;
+        load_before(state, count < state->winfirst ? count : state->winfirst);
+    }
+    int after = state->numrows - state->cy;
+    if (after < margin && state->winlast < state->lines->count) {
+        int count = EDDIE_WINDOW_ROWS - after;
+        long long left = state->lines->count - state->winlast;
+        load_after(state, count < left ? count : left);
+    }
+
+    // drop rows once more than one and a half windows piled up behind the cursor
+    int excess = state->cy - EDDIE_WINDOW_ROWS;
+    if (excess > margin) {
+        int count = excess < state->winhead ? excess : state->winhead;
+        editorDropRows(state, 0, count);
+        state->winfirst += count;
+        state->cy -= count;
+        state->rowoff -= count;
+        for (int j = 0; j < excess - count; j++)
+            editorUnprepareRow(state, editorRow(state, j)); // kept for its edits, but not displayed
+    }
+    excess = state->numrows - state->cy - EDDIE_WINDOW_ROWS;
+    if (excess > margin) {
+        int count = excess < state->wintail ? excess : state->wintail;
+        editorDropRows(state, state->numrows - count, count);
+        state->winlast -= count;
+        for (int j = state->cy + EDDIE_WINDOW_ROWS; j < state->numrows; j++)
+            editorUnprepareRow(state, editorRow(state, j));
+    }
+}
+
+int editorWindowFind(eState *state, const char *query, int direction) {
+    size_t qlen = strlen(query);
+    if (state->lines == NULL || qlen == 0 || state->winhead < state->numrows)
+        return -1;
+
+    struct lineidx *lines = state->lines;
+    size_t size = (lines->off[lines->count] < state->mapsize) ? lines->off[lines->count] : state->mapsize;
+    size_t start = lines->off[state->winfirst];
+    size_t end = (state->winlast < lines->count) ? lines->off[state->winlast] : size;
+    char *match; // only in the indexed lines, while the file is still loading
+    if (direction == 1) {
+        match = memmem(state->map + end, size - end, query, qlen);
+        if (match == NULL)
+            match = memmem(state->map, start, query, qlen);
+    } else {
+        match = find_last(state->map, start, query, qlen);
+        if (match == NULL)
+            match = find_last(state->map + end, size - end, query, qlen);
+    }
+    if (match == NULL)
+        return -1;
+
+    long long line = lineIndexFind(lines, match - state->map);
+    if (editorWindowGoto(state, line) == -1)
+        return -1;
+    return line - state->winfirst;
+}
+
+int editorWindowGoto(eState *state, long long line) {
+    if (state->winhead < state->numrows)
+        return -1;
+
+    editorDropRows(state, 0, state->numrows);
+    long long first = line - EDDIE_WINDOW_ROWS;
+    if (first < 0)
+        first = 0;
+    long long count = state->lines->count - first;
+    if (count > 2 * EDDIE_WINDOW_ROWS)
+        count = 2 * EDDIE_WINDOW_ROWS;
+
+    // an unchanged window means the lines are where the index says on disk too
+    state->winfirst = first;
+    state->winlast = first;
+    state->modrow = 0;
+    if (state->modoff != -1)
+        state->modoff = state->lines->off[first];
+    load_after(state, count);
+
+    state->cx = 0;
+    state->cy = 0;
+    state->rowoff = 0;
+    state->wrapoff = 0;
+    state->ix = 0;
+    state->iy = 0;
+    return 0;
+}
+
+void editorWindowReach(eState *state, long long line) {
+    if (state->lines == NULL)
+        return;
+    if (line < state->winfirst)
+        load_before(state, state->winfirst - (line > 0 ? line : 0));
+    long long after = line - (state->winfirst + state->numrows) + 1; // lines after the window up to line
+    long long left = state->lines->count - state->winlast;
+    if (after > 0)
+        load_after(state, after < left ? after : left);
+}
+
+int editorWindowExtend(eState *state, int fd, size_t size) {
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    for (int j = 0; j < state->numrows; j++) {
+        erow *row = editorRow(state, j);
+        if (ROW_FLAGS(row) & ROW_MAPPED) // the old bytes didn't change, only moved with the mapping
+            row->chars = &map[row->chars - state->map];
+    }
+    munmap(state->map, state->mapsize);
+
+    struct lineidx *lines = state->lines;
+    long long count = lines->count;
+    int partial = (count > 0 && lines->off[count] > state->mapsize);
+    lineIndexExtend(lines, map, state->mapsize, size);
+    state->map = map;
+    state->mapsize = size;
+    state->disksize = size;
+
+    editorSetLineCount(state, lines->count);
+    if (state->winlast < count)
+        return 0; // the appended lines are loaded once the window gets there
+
+    if (partial && state->wintail > 0) { // reload the unchanged last line with its continuation
+        editorDropRows(state, state->numrows - 1, 1);
+        state->winlast--;
+    }
+    long long left = lines->count - state->winlast;
+    load_after(state, left < EDDIE_WINDOW_ROWS ? left : EDDIE_WINDOW_ROWS);
+    return 0;
+}
+
+void editorWindowRebase(eState *state) {
+    struct lineidx *lines = state->lines;
+    if (lines == NULL)
+        return;
+
+    int fd = open(state->filename, O_RDONLY);
+    if (fd == -1)
+        return;
+    struct stat st;
+    char *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return; // keep loading rows from the old mapping, the edited rows stay in the window
+
+    size_t *lens = malloc(sizeof(size_t) * (state->numrows + 1));
+    size_t size = lines->off[lines->count] - (lines->off[state->winlast] - lines->off[state->winfirst]);
+    for (int j = 0; j < state->numrows; j++) {
+        lens[j] = editorRowFileLen(state, editorRow(state, j));
+        size += lens[j];
+    }
+    if (state->winlast < lines->count && lines->off[lines->count] > state->mapsize)
+        size--; // the last line still has no newline
+    if (size != (size_t)st.st_size) { // the file was changed by someone else since
+        munmap(map, st.st_size);
+        free(lens);
+        return;
+    }
+
+    lineIndexSplice(lines, state->winfirst, state->winlast, lens, state->numrows);
+    free(lens);
+    for (int j = 0; j < state->numrows; j++) {
+        erow *row = editorRow(state, j);
+        if (ROW_FLAGS(row) & ROW_MAPPED)
+            row->chars = &map[lines->off[state->winfirst + j]];
+    }
+    munmap(state->map, state->mapsize);
+    state->map = map;
+    state->mapsize = st.st_size;
+    state->map_current = 1;
+    state->winlast = state->winfirst + state->numrows;
+    state->winhead = state->numrows;
+    state->wintail = state->numrows;
+}
+
+long long editorTotalRows(eState *state) {
+    if (state->lines == NULL)
+        return state->numrows;
+    return state->winfirst + state->numrows + (state->lines->count - state->winlast);
+}
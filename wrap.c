@@ -0,0 +1,404 @@
+#include "syshead.h"
+
+#include "wrap.h"
+#include "buffer.h"
+#include "consts.h"
+#include "rowidx.h"
+#include "slab.h"
+#include "structs.h"
+
+/**
+ * @brief Where a pass laying out the chars of a row into its render stands.
+ * 
+ * {
+ *      int j; (index of the next char to lay out)
+ *      int idx; (length of the render so far)
+ *      int col; (column in the current screen row)
+ *      int wraps; (number of wraps so far)
+ * }
+ */
+struct layoutPos {
+    int j;
+    int idx;
+    int col;
+    int wraps;
+};
+
+/**
+ * @brief A single char edit of a rendered row, with the layout from before
+ *        it, so the row can be laid out again from the edit on only.
+ * 
+ * {
+ *      char *render; (render before the edit, from the char at @from on)
+ *      int from; (index in the old render of the first char in render)
+ *      int rsize; (length of the old render)
+ *      int *wrap_stops; (wrap stops before the edit)
+ *      int wraps; (number of wraps before the edit)
+ *      int at; (index of the edit in the chars)
+ *      int delta; (1 for an inserted char, -1 for a deleted one)
+ *      char removed; (the deleted char)
+ *      int same; (wraps after this char are decided as before the edit)
+ * }
+ */
+struct rowEdit {
+    char *render;
+    int from;
+    int rsize;
+    int *wrap_stops;
+    int wraps;
+    int at;
+    int delta;
+    char removed;
+    int same;
+};
+
+/**
+ * @brief The character at @i in the text of a row as it was before an edit.
+ * 
+ * @param row (the edited row)
+ * @param edit (the edit)
+ * @param i (index of the character before the edit)
+ * @return char (the character)
+ */
+static char old_char(erow *row, struct rowEdit *edit, int i) {
+    if (i < edit->at)
+        return editorRowChar(row, i);
+    if (edit->delta > 0)
+        return editorRowChar(row, i + 1);
+    return (i == edit->at) ? edit->removed : editorRowChar(row, i - 1);
+}
+
+/**
+ * @brief Follows the render from before an edit over one more char, the
+ *        way it was laid out then (including the wrap before the char).
+ * 
+ * @param row (the edited row)
+ * @param edit (the edit)
+ * @param pos (position in the old render, advanced past char pos->j)
+ */
+static void old_step(erow *row, struct rowEdit *edit, struct layoutPos *pos) {
+    if (pos->idx < edit->rsize && edit->render[pos->idx - edit->from] == '\n') {
+        pos->idx++;
+        pos->wraps++;
+        pos->col = 0;
+    }
+    if (old_char(row, edit, pos->j) == '\t') {
+        do {
+            pos->idx++;
+            pos->col++;
+        } while (pos->idx % EDDIE_TAB_STOP != 0);
+    } else {
+        pos->idx++;
+        pos->col++;
+    }
+    pos->j++;
+}
+
+/**
+ * @brief Makes room for @need bytes in the render of a row, and as many in
+ *        each of its highlight arrays. They share a single block with the
+ *        render details, which only grows (by half again at least) when @need
+ *        is past its capacity. The render is kept when it moves, the highlight
+ *        arrays are filled in again after every layout.
+ *        A row shown from its chars has no render in the block - the block
+ *        gets room for one once the row needs it, and shrinks again when the
+ *        row no longer does.
+ * 
+ * @param row (the row being laid out)
+ * @param need (number of bytes needed)
+ * @param own (whether the row needs a render of its own)
+ */
+static void reserve_render(erow *row, int need, int own) {
+    erender *rd = row->rd;
+    if (rd != NULL && need <= rd->cap && own == (rd->render != NULL))
+        return;
+
+    int cap = need;
+    if (rd != NULL && need <= rd->cap)
+        cap = rd->cap; // only the render moves in or out
+    else if (rd != NULL && cap < rd->cap + rd->cap / 2)
+        cap = rd->cap + rd->cap / 2;
+    size_t size = sizeof(erender) + (own ? 3 : 2) * (size_t)cap;
+    if (rd != NULL && !own && rd->render != NULL) { // the render goes back to the chars
+        erender *shrunk = slabAlloc(size);
+        memcpy(shrunk, rd, sizeof(erender));
+        slabFree(rd);
+        rd = shrunk;
+    } else {
+        rd = slabRealloc(rd, size);
+        if (row->rd == NULL) { // rendered for the first time
+            rd->rsize = 0;
+            rd->wrap_stops = NULL;
+        }
+    }
+    rd->cap = cap;
+    char *planes = rd->data;
+    rd->render = own ? planes : NULL;
+    if (own)
+        planes += cap;
+    rd->hl = (unsigned char *)planes;
+    rd->bg = (unsigned char *)&planes[cap];
+    row->rd = rd;
+}
+
+/**
+ * @brief Sets the number of wraps of a row, keeping the count of screen
+ *        rows in the row index up to date.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row)
+ * @param wraps (number of wraps)
+ */
+static void set_wraps(eState *state, erow *row, int wraps) {
+    if (wraps != ROW_WRAPS(row))
+        rowIndexAddLines(state->rows, row, wraps - ROW_WRAPS(row));
+    ROW_WRAPS(row) = wraps;
+}
+
+/**
+ * @brief Ends a layout pass that reached a wrap the render from before the
+ *        edit has as well, by reusing the rest of the old render and wrap
+ *        stops - everything after it is laid out the same.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the edited row)
+ * @param pos (the new layout, just after the wrap)
+ * @param edit (the edit)
+ * @param old (the old layout, at the same wrap)
+ */
+static void reuse_layout(eState *state, erow *row, struct layoutPos *pos, struct rowEdit *edit, struct layoutPos *old) {
+    int tail = edit->rsize - old->idx - 1;
+    int stops = edit->wraps - old->wraps; // stops of the screen rows after the wrap
+    reserve_render(row, pos->idx + tail + 1, 1);
+    memcpy(&row->rd->render[pos->idx], &edit->render[old->idx + 1 - edit->from], tail);
+    row->rd->rsize = pos->idx + tail;
+    row->rd->render[row->rd->rsize] = '\0';
+    row->rd->wrap_stops = slabRealloc(row->rd->wrap_stops, (pos->wraps + stops) * sizeof(int));
+    memcpy(&row->rd->wrap_stops[pos->wraps], &edit->wrap_stops[old->wraps + 1], stops * sizeof(int));
+    set_wraps(state, row, pos->wraps + stops - 1);
+}
+
+/**
+ * @brief Lays out the chars of a row from @pos on: tabs are rendered to
+ *        spaces and soft wraps are inserted (if set). The render and wrap
+ *        stops of the row already hold the layout of the chars before @pos.
+ *        Distances to the spaces around a char are kept along the way, so
+ *        the pass is linear in the length of the row.
+ *        For an edit, the pass stops at the first wrap after the edited word
+ *        that the layout from before the edit has as well.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row being laid out)
+ * @param pos (where the pass starts)
+ * @param edit (the edit the row is laid out again for, NULL for a whole row)
+ */
+static void layout_row(eState *state, erow *row, struct layoutPos pos, struct rowEdit *edit) {
+#ifdef DO_SOFTWRAP
+    int prev_space = pos.j - 1; // last space before the char, -1 for none
+    while (prev_space >= 0 && !isspace(editorRowChar(row, prev_space)))
+        prev_space--;
+    int next_space = pos.j; // first space after the char, size for none
+    struct layoutPos old = pos;
+#else
+    (void)edit;
+#endif /* DO_SOFTWRAP */
+    int cap = row->rd->cap;
+    for (; pos.j < ROW_SIZE(row); pos.j++) {
+        char c = editorRowChar(row, pos.j);
+#ifdef DO_SOFTWRAP
+        if (next_space <= pos.j) {
+            next_space = pos.j + 1;
+            while (next_space < ROW_SIZE(row) && !isspace(editorRowChar(row, next_space)))
+                next_space++;
+        }
+        if ((isspace(c) && // next word will overflow the display
+                pos.col + next_space - pos.j >= state->editcols) ||
+            (pos.col >= state->editcols && // word is too long to avoid breaking
+                pos.j - prev_space >= state->editcols / 2)) {
+            pos.wraps++;
+            row->rd->wrap_stops = slabRealloc(row->rd->wrap_stops, pos.wraps * sizeof(int));
+            row->rd->wrap_stops[pos.wraps - 1] = pos.col;
+            pos.col = 0;
+            if (pos.idx + 1 >= cap) {
+                reserve_render(row, pos.idx + 2, 1);
+                cap = row->rd->cap;
+            }
+            row->rd->render[pos.idx++] = '\n';
+            if (edit && pos.j > edit->same) {
+                while (old.j < pos.j - edit->delta)
+                    old_step(row, edit, &old);
+                if (edit->render[old.idx - edit->from] == '\n' && (pos.idx - 1 - old.idx) % EDDIE_TAB_STOP == 0) {
+                    reuse_layout(state, row, &pos, edit, &old);
+                    return;
+                }
+            }
+        }
+        if (isspace(c))
+            prev_space = pos.j;
+#endif /* DO_SOFTWRAP */
+        int width = (c == '\t') ? EDDIE_TAB_STOP - pos.idx % EDDIE_TAB_STOP : 1;
+        if (pos.idx + width >= cap) {
+            reserve_render(row, pos.idx + width + 1, 1);
+            cap = row->rd->cap;
+        }
+        if (c == '\t') {
+            do {
+                row->rd->render[pos.idx++] = ' ';
+                pos.col++;
+            } while (pos.idx % EDDIE_TAB_STOP != 0);
+        } else {
+            row->rd->render[pos.idx++] = c;
+            pos.col++;
+        }
+    }
+    set_wraps(state, row, pos.wraps);
+#ifdef DO_SOFTWRAP
+    row->rd->wrap_stops = slabRealloc(row->rd->wrap_stops, (ROW_WRAPS(row) + 1) * sizeof(int));
+    row->rd->wrap_stops[ROW_WRAPS(row)] = pos.col; // set last wrap stop to end of the row
+#endif /* DO_SOFTWRAP */
+    row->rd->render[pos.idx] = '\0';
+    row->rd->rsize = pos.idx;
+}
+
+/**
+ * @brief Lays out the chars of a row whole, see wrapLayoutRow.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the row being laid out)
+ */
+static void layout_full(eState *state, erow *row) {
+    // Calculate the number of tabs first, to allocate enoguh memory for render
+    int tabs = 0;
+    int j;
+    for (j = 0; j < ROW_SIZE(row); j++)
+        if (editorRowChar(row, j) == '\t')
+            tabs++;
+
+    // chars without tabs that fit a screen row (and so have no wraps) are
+    // shown as they are, unless they have a gap in them
+    int own = tabs > 0 || (row->gaplen > 0 && row->gap < ROW_SIZE(row));
+#ifdef DO_SOFTWRAP
+    own = own || ROW_SIZE(row) >= state->editcols;
+#endif /* DO_SOFTWRAP */
+
+    // the render is laid out in place when it fits; wrap stops are not
+    // taken into account, the render grows during the pass if necessary.
+    reserve_render(row, (ROW_SIZE(row) + tabs * (EDDIE_TAB_STOP - 1)) + 1, own);
+    row->rd->cols = state->editcols;
+
+    slabFree(row->rd->wrap_stops);
+    row->rd->wrap_stops = slabAlloc(sizeof(int)); // start with single int array
+    row->rd->wrap_stops[0] = state->editcols;
+    if (!own) {
+        set_wraps(state, row, 0);
+#ifdef DO_SOFTWRAP
+        row->rd->wrap_stops[0] = ROW_SIZE(row); // the only wrap stop is the end of the row
+#endif /* DO_SOFTWRAP */
+        row->rd->rsize = ROW_SIZE(row);
+        return;
+    }
+    layout_row(state, row, (struct layoutPos){0, 0, 0, 0}, NULL);
+}
+
+#ifdef DEBUG
+/**
+ * @brief Lays out an edited row whole next to the layout of the edit, and
+ *        aborts if they differ - the render (or the chars a row that fits
+ *        is shown from), the wraps or the wrap stops. Debug builds only.
+ * 
+ * @param state (pointer to the editor state object)
+ * @param row (the edited row, laid out again for the edit)
+ */
+static void check_edit(eState *state, erow *row) {
+    erender *edited = row->rd;
+    int wraps = ROW_WRAPS(row);
+    row->rd = NULL;
+    layout_full(state, row);
+    erender *full = row->rd;
+    char *text = full->render ? full->render : row->chars;
+
+    int same = (full->rsize == edited->rsize && ROW_WRAPS(row) == wraps &&
+                !memcmp(text, edited->render, edited->rsize));
+#ifdef DO_SOFTWRAP
+    same = same && !memcmp(full->wrap_stops, edited->wrap_stops, (wraps + 1) * sizeof(int));
+#endif /* DO_SOFTWRAP */
+    if (!same) {
+        fprintf(stderr, "the layout of an edit of a row of %d chars differs from laying it out whole\n", ROW_SIZE(row));
+        abort();
+    }
+
+    slabFree(full->wrap_stops);
+    slabFree(full);
+    row->rd = edited;
+    set_wraps(state, row, wraps);
+}
+#endif /* DEBUG */
+
+void wrapLayoutRow(eState *state, erow *row) {
+    debug_printf("laying out a row of %d chars in full", ROW_SIZE(row));
+    layout_full(state, row);
+}
+
+void wrapLayoutEdit(eState *state, erow *row, int at, int delta, char removed) {
+    static char *scratch = NULL; // the old render after the chars laid out as before
+    static int scratch_size = 0;
+
+    if (row->rd->render == NULL || // the old render is the chars, which already changed
+        row->rd->cols != state->editcols) { // or the wraps were for another width
+        wrapLayoutRow(state, row);
+        return;
+    }
+    debug_printf("laying out an edit at %d of a row of %d chars", at, ROW_SIZE(row));
+
+    struct rowEdit edit = {row->rd->render, 0, row->rd->rsize, row->rd->wrap_stops, ROW_WRAPS(row), at, delta, removed, ROW_SIZE(row)};
+    for (int j = at + (delta > 0); j < ROW_SIZE(row); j++) {
+        if (isspace(editorRowChar(row, j))) {
+            edit.same = j;
+            break;
+        }
+    }
+
+    // wraps before the word the edit is in are decided as before
+    int from = at - 1;
+    while (from > 0 && !isspace(editorRowChar(row, from)))
+        from--;
+    struct layoutPos pos = {0, 0, 0, 0};
+    while (pos.j < from)
+        old_step(row, &edit, &pos);
+
+    // the row is laid out again over the old render, which is followed in a copy
+    int tail = edit.rsize - pos.idx + 1;
+    if (tail > scratch_size) {
+        scratch_size = tail;
+        scratch = realloc(scratch, scratch_size);
+    }
+    memcpy(scratch, &edit.render[pos.idx], tail);
+    edit.render = scratch;
+    edit.from = pos.idx;
+
+    row->rd->wrap_stops = slabAlloc((pos.wraps + 1) * sizeof(int));
+    memcpy(row->rd->wrap_stops, edit.wrap_stops, pos.wraps * sizeof(int));
+    row->rd->wrap_stops[pos.wraps] = state->editcols;
+    layout_row(state, row, pos, &edit);
+    slabFree(edit.wrap_stops);
+    if (scratch_size > EDDIE_SCRATCH_KEEP) { // kept only as long as typical rows need
+        free(scratch);
+        scratch = NULL;
+        scratch_size = 0;
+    }
+#ifdef DEBUG
+    check_edit(state, row);
+#endif /* DEBUG */
+}
+
+void wrapClear(eState *state, erow *row) {
+    set_wraps(state, row, 0);
+}
+
+long long wrapScreenRow(eState *state, int filerow, int wrapoff) {
+    return rowIndexLine(state->rows, filerow) + wrapoff;
+}
+
+int wrapFileRow(eState *state, long long screenrow, int *wrapoff) {
+    return rowIndexAtLine(state->rows, screenrow, wrapoff);
+}